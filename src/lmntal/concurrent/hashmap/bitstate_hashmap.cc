@@ -0,0 +1,136 @@
+/**
+ * @file   bitstate_hashmap.cc
+ * @brief  
+ * @author Taketo Yoshida
+ */
+#include "bitstate_hashmap.h"
+#include "table_alloc.h"
+#include "../thread.h"
+#include <math.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define BITSTATE_WORD_BITS   (sizeof(lmn_word) * 8)
+#define BITSTATE_WORD_SHIFT  6
+#define BITSTATE_SALT        0x9e3779b97f4a7c15ULL
+
+/*
+ * private functions
+ */
+
+/* double hashing: the i-th bit of key is (a + i * b) & mask */
+inline void bitstate_indices(bitstate_hashmap_t *map, lmn_key_t key, lmn_word *idx) {
+  lmn_word h1 = hash<lmn_word>(key);
+  lmn_word h2 = hash<lmn_word>(key ^ BITSTATE_SALT);
+  lmn_word a  = (h1 << 32) | h2;
+  lmn_word b  = ((h2 << 32) | h1) | 1;
+  for (int i = 0; i < map->nhashes; i++) {
+    idx[i] = (a + i * b) & map->bit_mask;
+    LMN_PREFETCH((void*)&map->bits[idx[i] >> BITSTATE_WORD_SHIFT], 0, 3);
+  }
+}
+
+inline lmn_word bitstate_bit(lmn_word idx) {
+  return (lmn_word)1 << (idx & (BITSTATE_WORD_BITS - 1));
+}
+
+inline int bitstate_test(bitstate_hashmap_t *map, lmn_key_t key) {
+  lmn_word idx[BITSTATE_MAX_HASH];
+  bitstate_indices(map, key, idx);
+  for (int i = 0; i < map->nhashes; i++) {
+    if (!(map->bits[idx[i] >> BITSTATE_WORD_SHIFT] & bitstate_bit(idx[i]))) return FALSE;
+  }
+  return TRUE;
+}
+
+/* returns TRUE if any bit of key was clear, i.e. the state is new */
+inline int bitstate_set(bitstate_hashmap_t *map, lmn_key_t key) {
+  lmn_word idx[BITSTATE_MAX_HASH];
+  lmn_word set = 0;
+  bitstate_indices(map, key, idx);
+  for (int i = 0; i < map->nhashes; i++) {
+    lmn_word volatile *word = &map->bits[idx[i] >> BITSTATE_WORD_SHIFT];
+    lmn_word bit = bitstate_bit(idx[i]);
+    // read first, so revisiting a state does not take the line exclusive
+    if (!(*word & bit) && !(LMN_ATOMIC_AND_OR(word, bit) & bit)) {
+      set++;
+    }
+  }
+  if (set) {
+    bitstate_counter_t *counter = &map->counter[GetCurrentThreadId()];
+    LMN_ATOMIC_ADD(&counter->states, 1);
+    LMN_ATOMIC_ADD(&counter->bits, set);
+  }
+  return set != 0;
+}
+
+/*
+ * public functions
+ */
+
+void bitstate_init(bitstate_hashmap_t *map) {
+  bitstate_init_with_size(map, BITSTATE_DEFAULT_BITS, BITSTATE_DEFAULT_HASH);
+}
+
+/* nbits is rounded up to a power of two */
+void bitstate_init_with_size(bitstate_hashmap_t *map, lmn_word nbits, int nhashes) {
+  lmn_word size = BITSTATE_WORD_BITS;
+  while (size < nbits) size <<= 1;
+  LMN_ASSERT(nhashes > 0 && nhashes <= BITSTATE_MAX_HASH);
+  map->bits     = lmn_table_calloc(lmn_word, size / BITSTATE_WORD_BITS);
+  map->bit_mask = size - 1;
+  map->nhashes  = nhashes;
+  map->counter  = lmn_calloc(bitstate_counter_t, LMN_MAX_THREADS);
+}
+
+lmn_data_t bitstate_find(bitstate_hashmap_t *map, lmn_key_t key) {
+  return bitstate_test(map, key) ? BITSTATE_PRESENT : LMN_HASH_EMPTY_DATA;
+}
+
+/* only the key is recorded, data is dropped */
+void bitstate_put(bitstate_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  bitstate_set(map, key);
+}
+
+void bitstate_free(bitstate_hashmap_t *map) {
+  lmn_table_free(map->bits, lmn_word, bitstate_nbits(map) / BITSTATE_WORD_BITS);
+  lmn_free(map->counter);
+}
+
+int bitstate_set_contains(bitstate_hashmap_t *map, lmn_key_t key) {
+  return bitstate_test(map, key);
+}
+
+int bitstate_set_insert(bitstate_hashmap_t *map, lmn_key_t key) {
+  return bitstate_set(map, key);
+}
+
+lmn_word bitstate_nbits(bitstate_hashmap_t *map) {
+  return map->bit_mask + 1;
+}
+
+lmn_word bitstate_count(bitstate_hashmap_t *map) {
+  lmn_word count = 0;
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    count += map->counter[i].states;
+  }
+  return count;
+}
+
+/*
+ * Probability that the next new state is wrongly reported as visited:
+ * all of its nhashes bits are already set, (bits set / bits)^nhashes.
+ */
+double bitstate_omission_probability(bitstate_hashmap_t *map) {
+  lmn_word bits = 0;
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    bits += map->counter[i].bits;
+  }
+  return pow((double)bits / (double)bitstate_nbits(map), map->nhashes);
+}
+
+}
+}
+}
@@ -0,0 +1,55 @@
+/**
+ * @file   bitstate_hashmap.h
+ * @brief
+ * Lock-free bitstate hashing (a Bloom filter over visited states) in the style of SPIN's supertrace.
+ * Every key sets nhashes bits of one shared bit array; a key is reported as present when all of
+ * its bits are set, so a new state is omitted with a small probability instead of being stored.
+ * Bitstate hashing : G. J. Holzmann, "An Analysis of Bitstate Hashing", FMSD 13(3), 1998
+ * @author Taketo Yoshida
+ */
+#ifndef BITSTATE_HASHMAP_H
+#  define BITSTATE_HASHMAP_H
+
+#include "hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define BITSTATE_PRESENT       ((lmn_data_t)1)
+#define BITSTATE_DEFAULT_BITS  ((lmn_word)LMN_DEFAULT_SIZE << 3)
+#define BITSTATE_DEFAULT_HASH  3
+#define BITSTATE_MAX_HASH      16
+
+typedef struct {
+  lmn_word volatile states; // keys which set at least one new bit
+  lmn_word volatile bits;   // bits turned from 0 to 1
+  char              padding[LMN_CACHE_LINE_SIZE - 2 * sizeof(lmn_word)];
+} bitstate_counter_t;
+
+typedef struct {
+  lmn_word volatile  *bits;
+  lmn_word            bit_mask;
+  int                 nhashes;
+  bitstate_counter_t *counter; // per thread
+} bitstate_hashmap_t;
+
+void bitstate_init(bitstate_hashmap_t *map);
+void bitstate_init_with_size(bitstate_hashmap_t *map, lmn_word nbits, int nhashes);
+lmn_data_t bitstate_find(bitstate_hashmap_t *map, lmn_key_t key);
+void bitstate_put(bitstate_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+void bitstate_free(bitstate_hashmap_t *map);
+
+int bitstate_set_contains(bitstate_hashmap_t *map, lmn_key_t key);
+int bitstate_set_insert(bitstate_hashmap_t *map, lmn_key_t key);
+
+lmn_word bitstate_nbits(bitstate_hashmap_t *map);
+lmn_word bitstate_count(bitstate_hashmap_t *map);
+double bitstate_omission_probability(bitstate_hashmap_t *map);
+
+}
+}
+}
+
+#endif /* ifndef BITSTATE_HASHMAP_H */
+
@@ -0,0 +1,134 @@
+/**
+ * @file   bulk_load.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "bulk_load.h"
+#include "../thread.h"
+#include <algorithm>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+typedef struct {
+  bulk_partition_t *p;
+  const lmn_key_t  *keys;
+  const lmn_data_t *values;
+  lmn_word          n;
+  lmn_word         *offsets;  // nthreads x partitions, counts and then scatter positions
+} bulk_build_t;
+
+/*
+ * private functions
+ */
+
+inline int bulk_partition_of(bulk_partition_t *p, lmn_key_t key) {
+  return (int)(bulk_bucket(p, key) >> p->shift);
+}
+
+inline void bulk_slice(bulk_build_t *b, int index, int nthreads, lmn_word *begin, lmn_word *end) {
+  *begin = b->n * index / nthreads;
+  *end   = b->n * (index + 1) / nthreads;
+}
+
+void bulk_histogram_worker(int index, int nthreads, void *arg) {
+  bulk_build_t *b = (bulk_build_t*)arg;
+  lmn_word *counts = &b->offsets[(lmn_word)index << b->p->bits];
+  lmn_word begin, end;
+  bulk_slice(b, index, nthreads, &begin, &end);
+  for (lmn_word i = begin; i < end; i++) {
+    counts[bulk_partition_of(b->p, b->keys[i])]++;
+  }
+}
+
+void bulk_scatter_worker(int index, int nthreads, void *arg) {
+  bulk_build_t *b = (bulk_build_t*)arg;
+  lmn_word *pos = &b->offsets[(lmn_word)index << b->p->bits];
+  lmn_word begin, end;
+  bulk_slice(b, index, nthreads, &begin, &end);
+  for (lmn_word i = begin; i < end; i++) {
+    lmn_word j = pos[bulk_partition_of(b->p, b->keys[i])]++;
+    b->p->keys[j]   = b->keys[i];
+    b->p->values[j] = b->values[i];
+  }
+}
+
+/*
+ * public functions
+ */
+
+void bulk_partition(bulk_partition_t *p, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, lmn_word mask, int min_shift, int nthreads) {
+  if (nthreads < 1) nthreads = 1;
+  int slot_bits = 0;
+  while (((lmn_word)1 << slot_bits) <= mask) slot_bits++;
+  if (min_shift > slot_bits) min_shift = slot_bits;
+
+  memset(p, 0x00, sizeof(bulk_partition_t));
+  p->bits     = std::min(BULK_PARTITION_BITS, slot_bits - min_shift);
+  p->shift    = slot_bits - p->bits;
+  p->mask     = mask;
+  p->nthreads = nthreads;
+  p->keys     = lmn_calloc(lmn_key_t, n + 1);
+  p->values   = lmn_calloc(lmn_data_t, n + 1);
+  p->deferred = lmn_calloc(bulk_deferred_t, nthreads);
+
+  bulk_build_t b;
+  lmn_word nparts = (lmn_word)1 << p->bits;
+  b.p       = p;
+  b.keys    = keys;
+  b.values  = values;
+  b.n       = n;
+  b.offsets = lmn_calloc(lmn_word, nparts * nthreads);
+  p->parts  = lmn_calloc(lmn_word, nparts + 1);
+  RunParallel(nthreads, bulk_histogram_worker, &b);
+  lmn_word pos = 0;
+  for (lmn_word part = 0; part < nparts; part++) {
+    p->parts[part] = pos;
+    for (int t = 0; t < nthreads; t++) {
+      lmn_word c = b.offsets[t * nparts + part];
+      b.offsets[t * nparts + part] = pos;
+      pos += c;
+    }
+  }
+  p->parts[nparts] = pos;
+  RunParallel(nthreads, bulk_scatter_worker, &b);
+  lmn_free(b.offsets);
+}
+
+void bulk_partition_free(bulk_partition_t *p) {
+  for (int t = 0; t < p->nthreads; t++) {
+    free(p->deferred[t].index);
+  }
+  lmn_free(p->deferred);
+  lmn_free(p->keys);
+  lmn_free(p->values);
+  lmn_free(p->parts);
+}
+
+int bulk_next_partition(bulk_partition_t *p) {
+  int part = LMN_ATOMIC_ADD(&p->cursor, 1);
+  return (part < (1 << p->bits)) ? part : -1;
+}
+
+void bulk_defer(bulk_partition_t *p, int thread, lmn_word i) {
+  bulk_deferred_t *d = &p->deferred[thread];
+  if (LMN_UNLIKELY(d->n == d->cap)) {
+    d->cap   = (d->cap == 0) ? 256 : d->cap << 1;
+    d->index = (lmn_word*)realloc(d->index, sizeof(lmn_word) * d->cap);
+  }
+  d->index[d->n++] = i;
+}
+
+void bulk_put_deferred(bulk_partition_t *p, hashmap_put_t put, lmn_map_t map) {
+  for (int t = 0; t < p->nthreads; t++) {
+    bulk_deferred_t *d = &p->deferred[t];
+    for (lmn_word i = 0; i < d->n; i++) {
+      put(map, p->keys[d->index[i]], p->values[d->index[i]]);
+    }
+  }
+}
+
+}
+}
+}
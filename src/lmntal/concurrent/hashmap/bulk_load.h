@@ -0,0 +1,71 @@
+/**
+ * @file   bulk_load.h
+ * @brief
+ * Radix partitioning of key/value pairs by destination bucket, shared by the bulk loads
+ * of the engines. Partition p holds the pairs whose home bucket lies in the p-th of 2^bits
+ * equal bucket ranges, so a thread owning a partition fills a disjoint region of the table,
+ * small enough to stay in its cache, with plain stores. Pairs an engine can not place
+ * inside its own range are deferred and put the usual way once every partition is done.
+ * @author Taketo Yoshida
+ */
+#ifndef BULK_LOAD_H
+#  define BULK_LOAD_H
+
+#include "hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define BULK_PARTITION_BITS 10 // as many as the scatter can feed without thrashing the TLB
+
+typedef struct {
+  lmn_word *index;
+  lmn_word  n;
+  lmn_word  cap;
+} bulk_deferred_t;
+
+typedef struct {
+  lmn_key_t        *keys;      // the input regrouped by partition
+  lmn_data_t       *values;
+  lmn_word         *parts;     // first pair of every partition, plus the end
+  int               bits;
+  int               shift;     // bucket >> shift is the partition
+  lmn_word          mask;      // bucket mask of the target table
+  int               nthreads;
+  int      volatile cursor;    // next partition to hand out
+  bulk_deferred_t  *deferred;  // one list per thread
+} bulk_partition_t;
+
+/*
+ * Partitions n pairs for a table of mask + 1 buckets (a power of two). Partitions
+ * are at least 2^min_shift buckets wide, so a cache line of slots never straddles two.
+ * Within a partition pairs keep their input order.
+ */
+void bulk_partition(bulk_partition_t *p, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, lmn_word mask, int min_shift, int nthreads);
+void bulk_partition_free(bulk_partition_t *p);
+
+/* hands out partitions to the workers of a RunParallel; -1 when none are left */
+int bulk_next_partition(bulk_partition_t *p);
+void bulk_defer(bulk_partition_t *p, int thread, lmn_word i);
+
+/* puts every deferred pair, thread list after thread list, in partition order */
+void bulk_put_deferred(bulk_partition_t *p, hashmap_put_t put, lmn_map_t map);
+
+inline lmn_word bulk_bucket(bulk_partition_t *p, lmn_key_t key) {
+  return hash<lmn_word>(key) & p->mask;
+}
+
+inline lmn_word bulk_range_begin(bulk_partition_t *p, int part) {
+  return (lmn_word)part << p->shift;
+}
+
+inline lmn_word bulk_range_end(bulk_partition_t *p, int part) {
+  return (lmn_word)(part + 1) << p->shift;
+}
+
+}
+}
+}
+
+#endif /* ifndef BULK_LOAD_H */
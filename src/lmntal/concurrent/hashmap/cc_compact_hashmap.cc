@@ -0,0 +1,275 @@
+/**
+ * @file   cc_compact_hashmap.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "cc_compact_hashmap.h"
+#include "table_alloc.h"
+#include "bulk_load.h"
+#include "hashmap_stats.h"
+#include "../thread.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define CC_COMPACT_PROB_FAIL  ((lmn_word)-1)
+#define CC_COMPACT_BATCH_GROUP 16
+#define CC_COMPACT_LINE_SHIFT  3 // log2 of the packed entries per cache line
+
+#define CC_COMPACT_PACK(k, v) (((lmn_word)(k) << CC_COMPACT_VALUE_BITS) | (lmn_word)(v))
+#define CC_COMPACT_KEY(w)     ((w) >> CC_COMPACT_VALUE_BITS)
+#define CC_COMPACT_VALUE(w)   ((w) & CC_COMPACT_VALUE_MAX)
+
+/*
+ * private functions
+ */
+
+inline void cc_compact_check_key(lmn_key_t key, lmn_word max) {
+  if (LMN_UNLIKELY(key == LMN_HASH_EMPTY_KEY || key > max)) {
+    fprintf(stderr, "compact key out of range: %lu\n", key);
+    exit(1);
+  }
+}
+
+/* slots per cache line: 8 packed entries, or 16 keys of the set */
+inline lmn_word cc_compact_entries(cc_compact_hashmap_t *map) {
+  return LMN_CACHE_LINE_SIZE / (map->keys != NULL ? sizeof(lmn_compact_key_t) : sizeof(lmn_word));
+}
+
+inline void cc_compact_init_probe(cc_compact_hashmap_t *map) {
+  map->probe     = CC_PROBE_LINEAR;
+  map->max_lines = cc_probe_lines(CC_PROBE_DEFAULT_LOAD, cc_compact_entries(map));
+}
+
+/*
+ * Same probing as cc_hashmap_lookup, over lines of LMN_CACHE_LINE_SIZE / sizeof(T)
+ * slots. SHIFT extracts the key from a slot: the packed map keeps it in the
+ * upper bits, the set stores it plain.
+ */
+template <typename T, int SHIFT>
+inline lmn_word cc_compact_lookup(cc_compact_hashmap_t *map, T volatile *slots, lmn_key_t key, int *is_empty) {
+  const lmn_word entries = LMN_CACHE_LINE_SIZE / sizeof(T);
+  lmn_word        offset = hash<lmn_word>(key);
+  lmn_word         start = offset;
+
+  for (int count = 0; count < map->max_lines; count++) {
+    lmn_word line = offset & map->bucket_mask & ~(entries - 1);
+    for (lmn_word i = 0; i < entries; i++) {
+      lmn_word index = line | ((offset + i) & (entries - 1));
+      lmn_word slot  = slots[index];
+      if (slot == LMN_HASH_EMPTY_KEY) {
+        LMN_PTR_VAL(is_empty) = TRUE;
+        return index;
+      } else if ((slot >> SHIFT) == key) {
+        LMN_PTR_VAL(is_empty) = FALSE;
+        return index;
+      }
+    }
+    offset = cc_probe_next_line(map->probe, start, offset, count, entries);
+  }
+  LMN_PTR_VAL(is_empty) = FALSE;
+  return CC_COMPACT_PROB_FAIL;
+}
+
+inline void cc_compact_full() {
+  fprintf(stderr, "full!!!!\n");
+  exit(1);
+}
+
+inline void cc_compact_check_value(lmn_data_t data) {
+  if (LMN_UNLIKELY((lmn_word)data > CC_COMPACT_VALUE_MAX)) {
+    fprintf(stderr, "compact value out of range: %lu\n", (lmn_word)data);
+    exit(1);
+  }
+}
+
+typedef struct {
+  cc_compact_hashmap_t *map;
+  bulk_partition_t     *p;
+} cc_compact_bulk_t;
+
+/* as cc_hashmap_bulk_place; pairs that do not fit the packing are left to the deferred put */
+inline int cc_compact_bulk_place(cc_compact_hashmap_t *map, lmn_key_t key, lmn_data_t data, lmn_word lo, lmn_word hi) {
+  const lmn_word entries = LMN_CACHE_LINE_SIZE / sizeof(lmn_word);
+  if (key == LMN_HASH_EMPTY_KEY || key > CC_COMPACT_KEY_MAX || (lmn_word)data > CC_COMPACT_VALUE_MAX) return FALSE;
+  lmn_word offset = hash<lmn_word>(key);
+  lmn_word  start = offset;
+  for (int count = 0; count < map->max_lines; count++) {
+    lmn_word line = offset & map->bucket_mask & ~(entries - 1);
+    if (line < lo || line >= hi) return FALSE;
+    for (lmn_word i = 0; i < entries; i++) {
+      lmn_word index = line | ((offset + i) & (entries - 1));
+      lmn_word slot  = map->slots[index];
+      if (slot == LMN_HASH_EMPTY_KEY) {
+        map->slots[index] = CC_COMPACT_PACK(key, (lmn_word)data);
+        return TRUE;
+      } else if (CC_COMPACT_KEY(slot) == key) {
+        return TRUE; // entry is immutable
+      }
+    }
+    offset = cc_probe_next_line(map->probe, start, offset, count, entries);
+  }
+  return FALSE;
+}
+
+void cc_compact_bulk_worker(int index, int nthreads, void *arg) {
+  cc_compact_bulk_t *b = (cc_compact_bulk_t*)arg;
+  bulk_partition_t  *p = b->p;
+  int part;
+  while ((part = bulk_next_partition(p)) >= 0) {
+    lmn_word lo = bulk_range_begin(p, part), hi = bulk_range_end(p, part);
+    for (lmn_word i = p->parts[part]; i < p->parts[part + 1]; i++) {
+      if (!cc_compact_bulk_place(b->map, p->keys[i], p->values[i], lo, hi)) bulk_defer(p, index, i);
+    }
+  }
+}
+
+/*
+ * public functions
+ */
+
+void cc_compact_init(cc_compact_hashmap_t *map) {
+  map->slots       = lmn_table_calloc(lmn_word, LMN_DEFAULT_SIZE);
+  map->keys        = NULL;
+  map->bucket_mask = LMN_DEFAULT_SIZE - 1;
+  cc_compact_init_probe(map);
+}
+
+lmn_data_t cc_compact_find(cc_compact_hashmap_t *map, lmn_key_t key) {
+  int is_empty;
+  cc_compact_check_key(key, CC_COMPACT_KEY_MAX);
+  lmn_word index = cc_compact_lookup<lmn_word, CC_COMPACT_VALUE_BITS>(map, map->slots, key, &is_empty);
+  if (index == CC_COMPACT_PROB_FAIL || is_empty) return LMN_HASH_EMPTY_DATA;
+  return (lmn_data_t)CC_COMPACT_VALUE(map->slots[index]);
+}
+
+/* like the CC map, entries are immutable once inserted */
+void cc_compact_put(cc_compact_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  int is_empty;
+  cc_compact_check_key(key, CC_COMPACT_KEY_MAX);
+  cc_compact_check_value(data);
+  for (;;) {
+    lmn_word index = cc_compact_lookup<lmn_word, CC_COMPACT_VALUE_BITS>(map, map->slots, key, &is_empty);
+    if (LMN_UNLIKELY(index == CC_COMPACT_PROB_FAIL)) cc_compact_full();
+    if (!is_empty) return;
+    if (LMN_CAS(&map->slots[index], LMN_HASH_EMPTY_KEY, CC_COMPACT_PACK(key, (lmn_word)data))) return;
+  }
+}
+
+/* key and value share the word, so an update is a single CAS of the whole entry */
+lmn_data_t cc_compact_update(cc_compact_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  int is_empty;
+  cc_compact_check_key(key, CC_COMPACT_KEY_MAX);
+  for (;;) {
+    lmn_word index = cc_compact_lookup<lmn_word, CC_COMPACT_VALUE_BITS>(map, map->slots, key, &is_empty);
+    if (LMN_UNLIKELY(index == CC_COMPACT_PROB_FAIL)) cc_compact_full();
+    lmn_word   slot = is_empty ? LMN_HASH_EMPTY_KEY : map->slots[index];
+    lmn_data_t  old = (lmn_data_t)CC_COMPACT_VALUE(slot);
+    lmn_data_t data = combiner(old, arg);
+    cc_compact_check_value(data);
+    // a lost race for an empty slot may have been won by another key, so look again
+    if (LMN_CAS(&map->slots[index], slot, CC_COMPACT_PACK(key, (lmn_word)data))) return old;
+  }
+}
+
+/* the value shares the key's word, so one prefetch of the first line covers both */
+void cc_compact_find_batch(cc_compact_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  for (int base = 0; base < n; base += CC_COMPACT_BATCH_GROUP) {
+    int m = (n - base < CC_COMPACT_BATCH_GROUP) ? n - base : CC_COMPACT_BATCH_GROUP;
+    for (int i = 0; i < m; i++) {
+      LMN_PREFETCH((void*)&map->slots[hash<lmn_word>(keys[base + i]) & map->bucket_mask], 0, 3);
+    }
+    for (int i = 0; i < m; i++) {
+      out[base + i] = cc_compact_find(map, keys[base + i]);
+    }
+  }
+}
+
+/* probe sequences leaving the range of their partition are put afterwards, with CAS */
+void cc_compact_bulk_load(cc_compact_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads) {
+  bulk_partition_t  p;
+  cc_compact_bulk_t b = { map, &p };
+  bulk_partition(&p, keys, values, n, map->bucket_mask, CC_COMPACT_LINE_SHIFT, nthreads);
+  RunParallel(nthreads, cc_compact_bulk_worker, &b);
+  bulk_put_deferred(&p, (hashmap_put_t)cc_compact_put, map);
+  bulk_partition_free(&p);
+}
+
+/* set after init and before the first put, as lmn_hashmap_set_probe */
+void cc_compact_set_probe(cc_compact_hashmap_t *map, int policy, double max_load) {
+  map->probe     = policy;
+  map->max_lines = cc_probe_lines(max_load, cc_compact_entries(map));
+}
+
+void cc_compact_free(cc_compact_hashmap_t *map) {
+  lmn_table_free(map->slots, lmn_word, cc_compact_slots(map));
+  lmn_table_free(map->keys, lmn_compact_key_t, cc_compact_slots(map));
+}
+
+lmn_word cc_compact_slots(cc_compact_hashmap_t *map) {
+  return map->bucket_mask + 1;
+}
+
+void cc_compact_scan(cc_compact_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  for (lmn_word i = begin; i < end; i++) {
+    lmn_word slot = map->slots[i];
+    if (slot != LMN_HASH_EMPTY_KEY) {
+      fn(CC_COMPACT_KEY(slot), (lmn_data_t)CC_COMPACT_VALUE(slot), arg);
+    }
+  }
+}
+
+/* fill counts the entries of every cache line, distance the lines probed before theirs */
+void cc_compact_stats(cc_compact_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_stats_t *out) {
+  const lmn_word entries = LMN_CACHE_LINE_SIZE / sizeof(lmn_word);
+  out->allocated += (end - begin) * sizeof(lmn_word);
+  out->committed += lmn_table_committed((void*)&map->slots[begin], (end - begin) * sizeof(lmn_word));
+  for (lmn_word line = begin; line < end; line += entries) {
+    lmn_word used = 0;
+    for (lmn_word i = line; i < line + entries && i < end; i++) {
+      lmn_word slot = map->slots[i];
+      if (slot == LMN_HASH_EMPTY_KEY) continue;
+      lmn_word offset = hash<lmn_word>(CC_COMPACT_KEY(slot));
+      lmn_word  start = offset;
+      int count = 0;
+      while (count < map->max_lines && (offset & map->bucket_mask & ~(entries - 1)) != line) {
+        offset = cc_probe_next_line(map->probe, start, offset, count, entries);
+        count++;
+      }
+      hashmap_stats_record(out->distance, count);
+      used++;
+    }
+    hashmap_stats_record(out->fill, used);
+    out->entries += used;
+  }
+}
+
+void cc_compact_set_init(cc_compact_hashmap_t *map) {
+  map->slots       = NULL;
+  map->keys        = lmn_table_calloc(lmn_compact_key_t, LMN_DEFAULT_SIZE);
+  map->bucket_mask = LMN_DEFAULT_SIZE - 1;
+  cc_compact_init_probe(map);
+}
+
+int cc_compact_set_contains(cc_compact_hashmap_t *map, lmn_key_t key) {
+  int is_empty;
+  cc_compact_check_key(key, (lmn_compact_key_t)-1);
+  lmn_word index = cc_compact_lookup<lmn_compact_key_t, 0>(map, map->keys, key, &is_empty);
+  return index != CC_COMPACT_PROB_FAIL && !is_empty;
+}
+
+int cc_compact_set_insert(cc_compact_hashmap_t *map, lmn_key_t key) {
+  int is_empty;
+  cc_compact_check_key(key, (lmn_compact_key_t)-1);
+  for (;;) {
+    lmn_word index = cc_compact_lookup<lmn_compact_key_t, 0>(map, map->keys, key, &is_empty);
+    if (LMN_UNLIKELY(index == CC_COMPACT_PROB_FAIL)) cc_compact_full();
+    if (!is_empty) return FALSE;
+    if (LMN_CAS(&map->keys[index], LMN_HASH_EMPTY_KEY, (lmn_compact_key_t)key)) return TRUE;
+  }
+}
+
+}
+}
+}
@@ -0,0 +1,56 @@
+/**
+ * @file   cc_compact_hashmap.h
+ * @brief
+ * Compact variant of the Cliff Click hash table for small keys and values.
+ * A key and its value are packed into one word, CC_COMPACT_KEY_BITS for the key and the
+ * rest for the value, so an entry takes 8 bytes instead of 16, a cache line holds 8 entries
+ * and an insert publishes key and value with a single CAS. The set specialization stores
+ * 32-bit keys only, 16 per cache line. Probing follows the CC map's policies (cc_hashmap.h).
+ * @author Taketo Yoshida
+ */
+#ifndef CC_COMPACT_HASHMAP_H
+#  define CC_COMPACT_HASHMAP_H
+
+#include "cc_hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define CC_COMPACT_KEY_BITS   32
+#define CC_COMPACT_VALUE_BITS (64 - CC_COMPACT_KEY_BITS)
+#define CC_COMPACT_KEY_MAX    ((1ULL << CC_COMPACT_KEY_BITS) - 1)
+#define CC_COMPACT_VALUE_MAX  ((1ULL << CC_COMPACT_VALUE_BITS) - 1)
+
+typedef unsigned int lmn_compact_key_t;
+
+typedef struct {
+  lmn_word          volatile *slots; // packed key:value array
+  lmn_compact_key_t volatile *keys;  // key array of the set specialization
+  lmn_word                    bucket_mask;
+  int                         probe;
+  int                         max_lines;
+} cc_compact_hashmap_t;
+
+void cc_compact_init(cc_compact_hashmap_t *map);
+lmn_data_t cc_compact_find(cc_compact_hashmap_t *map, lmn_key_t key);
+void cc_compact_put(cc_compact_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+lmn_data_t cc_compact_update(cc_compact_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg);
+void cc_compact_find_batch(cc_compact_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+void cc_compact_bulk_load(cc_compact_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads);
+void cc_compact_set_probe(cc_compact_hashmap_t *map, int policy, double max_load);
+void cc_compact_free(cc_compact_hashmap_t *map);
+lmn_word cc_compact_slots(cc_compact_hashmap_t *map);
+void cc_compact_scan(cc_compact_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+void cc_compact_stats(cc_compact_hashmap_t *map, lmn_word begin, lmn_word end, struct _hashmap_stats_t *out);
+
+void cc_compact_set_init(cc_compact_hashmap_t *map);
+int cc_compact_set_contains(cc_compact_hashmap_t *map, lmn_key_t key);
+int cc_compact_set_insert(cc_compact_hashmap_t *map, lmn_key_t key);
+
+}
+}
+}
+
+#endif /* ifndef CC_COMPACT_HASHMAP_H */
+
@@ -4,8 +4,12 @@
  * @author Taketo Yoshida
  */
 #include "cc_hashmap.h"
+#include "table_alloc.h"
+#include "bulk_load.h"
+#include "hashmap_stats.h"
 #include "../thread.h"
 #include <assert.h>
+#include <math.h>
 
 namespace lmntal {
 namespace concurrent {
@@ -23,7 +27,8 @@ using namespace lmntal::concurrent;
 #define CC_IMMUTABLE_FAIL ((lmn_data_t)-1)
 #define CC_CACHE_LINE_SIZE_FOR_UNIT64 8
 #define CC_PROB_FAIL -1
-#define THRESHOLD 2
+#define CC_BATCH_GROUP 16
+#define CC_LINE_SHIFT  3 // log2 of CC_CACHE_LINE_SIZE_FOR_UNIT64
 
 #define CC_NEXT_SCALE(map) ((cc_hashmap_tbl_size(map) < (1 << 20)) ? (cc_hashmap_tbl_size(map) << 3) : (cc_hashmap_tbl_size(map) << 1))
 
@@ -51,7 +56,7 @@ inline void cc_hashmap_inc_count(cc_hashmap_t *map) {
 inline lmn_word cc_hashmap_tbl_size(cc_hashmap_t *map) { return map->bucket_mask + 1; }
 
 inline int cc_hashmap_count(cc_hashmap_t *map) {
-  static int thread_count = GetCurrentThreadCount();
+  int thread_count = GetCurrentThreadCount(); // grows as threads register, so it is not cached
   int count = 0;
   for (int i = 0; i < thread_count; i++) {
     count += map->count[i];
@@ -72,8 +77,19 @@ void cc_hashmap_print(cc_hashmap_t *map, int content) {
   }
 }
 
+inline void cc_hashmap_probe_record(cc_hashmap_t *map, int lines) {
+  if (LMN_LIKELY(map->probe_hist == NULL)) return;
+  if (lines >= CC_PROBE_HIST) lines = CC_PROBE_HIST - 1;
+  map->probe_hist[GetCurrentThreadId() * CC_PROBE_HIST + lines]++;
+}
+
+inline lmn_word cc_hashmap_next_line(cc_hashmap_t *map, lmn_word start, lmn_word offset, int count) {
+  return cc_probe_next_line(map->probe, start, offset, count, CC_CACHE_LINE_SIZE_FOR_UNIT64);
+}
+
 inline lmn_word cc_hashmap_lookup(cc_hashmap_t *map, lmn_key_t key, int* is_empty) {
   lmn_word             offset = hash<lmn_word>(key);
+  lmn_word              start = offset;
   volatile lmn_key_t *buckets = map->buckets;
   lmn_word               mask = map->bucket_mask;
   int                   count = 0;
@@ -83,34 +99,69 @@ inline lmn_word cc_hashmap_lookup(cc_hashmap_t *map, lmn_key_t key, int* is_empt
     assert(key != CC_DOES_NOT_EXIST);
   }
 
-  while (count < THRESHOLD) {
-    // Walk Cache line
+  while (count < map->max_lines) {
+    // Walk the aligned cache line holding offset, wrapping around inside it
+    lmn_word line = offset & mask & ~(lmn_word)(CC_CACHE_LINE_SIZE_FOR_UNIT64 - 1);
     for (int i = 0; i < CC_CACHE_LINE_SIZE_FOR_UNIT64; i++) {
-      if (buckets[(offset + i) & mask] == CC_DOES_NOT_EXIST) {
+      lmn_word index = line | ((offset + i) & (CC_CACHE_LINE_SIZE_FOR_UNIT64 - 1));
+      if (buckets[index] == CC_DOES_NOT_EXIST) {
+        cc_hashmap_probe_record(map, count);
         LMN_PTR_VAL(is_empty) = TRUE;
-        return (offset + i) & mask;
-      } else if (buckets[(offset + i) & mask] == key)  {
+        return index;
+      } else if (buckets[index] == key)  {
+        cc_hashmap_probe_record(map, count);
         LMN_PTR_VAL(is_empty) = FALSE;
-        return (offset + i) & mask;
+        return index;
       }
-      //LMN_DBG("[debug] cc_hashmap_put_inner: retry hash, key %u, thread:%d\n", key, GetCurrentThreadId());
     }
-    offset = hash<lmn_word>(offset);
+    offset = cc_hashmap_next_line(map, start, offset, count);
     count++;
   }
+  cc_hashmap_probe_record(map, CC_PROBE_HIST - 1);
   LMN_PTR_VAL(is_empty) = FALSE;
   return CC_PROB_FAIL;
 }
 
+/* the lines a lookup of key probes before the line holding index, replaying its sequence */
+inline int cc_hashmap_probe_distance(cc_hashmap_t *map, lmn_key_t key, lmn_word index) {
+  lmn_word offset = hash<lmn_word>(key);
+  lmn_word  start = offset;
+  lmn_word target = index & ~(lmn_word)(CC_CACHE_LINE_SIZE_FOR_UNIT64 - 1);
+  for (int count = 0; count < map->max_lines; count++) {
+    if ((offset & map->bucket_mask & ~(lmn_word)(CC_CACHE_LINE_SIZE_FOR_UNIT64 - 1)) == target) return count;
+    offset = cc_hashmap_next_line(map, start, offset, count);
+  }
+  return map->max_lines;
+}
+
+inline int cc_hashmap_probe_lines(double max_load) {
+  return cc_probe_lines(max_load, CC_CACHE_LINE_SIZE_FOR_UNIT64);
+}
+
+
+inline void cc_hashmap_init_probe(cc_hashmap_t *map) {
+  map->probe        = CC_PROBE_LINEAR;
+  map->max_lines    = cc_hashmap_probe_lines(CC_PROBE_DEFAULT_LOAD);
+  map->probe_hist   = NULL;
+}
 
 inline void cc_hashmap_init_inner(cc_hashmap_t *map, lmn_word scale) {
-  map->buckets      = lmn_calloc(lmn_key_t,  scale);
-  map->data         = lmn_calloc(lmn_data_t, scale);
+  map->buckets      = lmn_table_calloc(lmn_key_t,  scale);
+  map->data         = lmn_table_calloc(lmn_data_t, scale);
   map->bucket_mask  = scale - 1;
-  map->count        = lmn_calloc(int, 100);
+  map->count        = lmn_calloc(int, LMN_MAX_THREADS);
+  cc_hashmap_init_probe(map);
 }
 
 
+inline void cc_hashset_init_inner(cc_hashmap_t *map, lmn_word scale) {
+  map->buckets      = lmn_table_calloc(lmn_key_t,  scale);
+  map->data         = NULL;
+  map->bucket_mask  = scale - 1;
+  map->count        = lmn_calloc(int, LMN_MAX_THREADS);
+  cc_hashmap_init_probe(map);
+}
+
 inline lmn_data_t cc_hashmap_put_inner(cc_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
   int is_empty;
   lmn_word index = cc_hashmap_lookup(map, key, &is_empty);
@@ -127,7 +178,8 @@ inline lmn_data_t cc_hashmap_put_inner(cc_hashmap_t *map, lmn_key_t key, lmn_dat
       LMN_DBG("[debug] cc_hashmap_put_inner: retry put entry {%u, %u, %u} thread:%d\n", index, key, data, GetCurrentThreadId());
       return cc_hashmap_put_inner(map, key, data); // retry
     }
-    map->data[index] = data;
+    // an update may have filled in the value since the key went in, see lmn_hashmap_update
+    if (!LMN_CAS(&map->data[index], (lmn_data_t)LMN_HASH_EMPTY_DATA, data)) return CC_IMMUTABLE_FAIL;
     //cc_hashmap_inc_count(map);
   } else {
     // entry is immutable
@@ -152,13 +204,71 @@ inline lmn_data_t cc_hashmap_find_inner(cc_hashmap_t *map, lmn_key_t key) {
   exit(1);
 }
 
+typedef struct {
+  cc_hashmap_t     *map;
+  bulk_partition_t *p;
+} cc_hashmap_bulk_t;
+
+/* the same walk as a lookup, which gives up as soon as it leaves [lo, hi) */
+inline int cc_hashmap_bulk_place(cc_hashmap_t *map, lmn_key_t key, lmn_data_t data, lmn_word lo, lmn_word hi) {
+  if (key == CC_DOES_NOT_EXIST) return FALSE; // the deferred put reports it
+  lmn_word offset = hash<lmn_word>(key);
+  lmn_word  start = offset;
+  for (int count = 0; count < map->max_lines; count++) {
+    lmn_word line = offset & map->bucket_mask & ~(lmn_word)(CC_CACHE_LINE_SIZE_FOR_UNIT64 - 1);
+    if (line < lo || line >= hi) return FALSE;
+    for (int i = 0; i < CC_CACHE_LINE_SIZE_FOR_UNIT64; i++) {
+      lmn_word index = line | ((offset + i) & (CC_CACHE_LINE_SIZE_FOR_UNIT64 - 1));
+      if (map->buckets[index] == CC_DOES_NOT_EXIST) {
+        map->buckets[index] = key;
+        map->data[index]    = data;
+        return TRUE;
+      } else if (map->buckets[index] == key) {
+        return TRUE; // entry is immutable
+      }
+    }
+    offset = cc_hashmap_next_line(map, start, offset, count);
+  }
+  return FALSE;
+}
+
+/* a thread is the only writer of the slots of the partitions it takes */
+void cc_hashmap_bulk_worker(int index, int nthreads, void *arg) {
+  cc_hashmap_bulk_t *b   = (cc_hashmap_bulk_t*)arg;
+  bulk_partition_t  *p   = b->p;
+  int part;
+  while ((part = bulk_next_partition(p)) >= 0) {
+    lmn_word lo = bulk_range_begin(p, part), hi = bulk_range_end(p, part);
+    for (lmn_word i = p->parts[part]; i < p->parts[part + 1]; i++) {
+      if (!cc_hashmap_bulk_place(b->map, p->keys[i], p->values[i], lo, hi)) bulk_defer(p, index, i);
+    }
+  }
+}
+
 /*
  * public function
  */
 
+/*
+ * An unsuccessful linear probe at load a is expected to visit (1 + 1/(1-a)^2) / 2
+ * slots; allowing four times that keeps "full" failures rare up to that load.
+ */
+int cc_probe_lines(double max_load, int entries) {
+  if (max_load >= 1.0) return CC_PROBE_MAX_LINES;
+  double slots = (1.0 + 1.0 / ((1.0 - max_load) * (1.0 - max_load))) / 2.0;
+  int    lines = (int)ceil(4.0 * slots / entries);
+  if (lines < 2) lines = 2;
+  return (lines > CC_PROBE_MAX_LINES) ? CC_PROBE_MAX_LINES : lines;
+}
+
 void lmn_hashmap_init(lmn_hashmap_t *lmn_map) {
+  lmn_hashmap_init_with_size(lmn_map, LMN_DEFAULT_SIZE);
+}
+
+/* slots must be a power of two */
+void lmn_hashmap_init_with_size(lmn_hashmap_t *lmn_map, lmn_word slots) {
   lmn_map->current = lmn_malloc(cc_hashmap_t);
-  cc_hashmap_init_inner(lmn_map->current, LMN_DEFAULT_SIZE);
+  cc_hashmap_init_inner(lmn_map->current, slots);
 }
 
 int lmn_hashmap_count(lmn_hashmap_t *lmn_map) {
@@ -167,10 +277,12 @@ int lmn_hashmap_count(lmn_hashmap_t *lmn_map) {
 
 void cc_hashmap_free(cc_hashmap_t *map) {
   if (map == NULL) return;
-  lmn_free((void*)map->buckets);
-  lmn_free((void*)map->data);
+  lmn_table_free(map->buckets, lmn_key_t, cc_hashmap_tbl_size(map));
+  lmn_table_free(map->data, lmn_data_t, cc_hashmap_tbl_size(map));
   if (map->count != NULL)
     lmn_free((void*)map->count);
+  if (map->probe_hist != NULL)
+    lmn_free(map->probe_hist);
 }
 
 void lmn_hashmap_free(lmn_hashmap_t *lmn_map) {
@@ -188,6 +300,194 @@ void lmn_hashmap_put(lmn_hashmap_t *lmn_map, lmn_key_t key, lmn_data_t data) {
   cc_hashmap_put_inner(map, key, data);
 }
 
+/*
+ * The first key line of every key in a group is prefetched before any of them
+ * is probed, and the data slots found are prefetched before they are read.
+ */
+void lmn_hashmap_find_batch(lmn_hashmap_t *lmn_map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  cc_hashmap_t *map = lmn_map->current;
+  lmn_word index[CC_BATCH_GROUP];
+  for (int base = 0; base < n; base += CC_BATCH_GROUP) {
+    int m = (n - base < CC_BATCH_GROUP) ? n - base : CC_BATCH_GROUP;
+    for (int i = 0; i < m; i++) {
+      LMN_PREFETCH((void*)&map->buckets[hash<lmn_word>(keys[base + i]) & map->bucket_mask], 0, 3);
+    }
+    for (int i = 0; i < m; i++) {
+      int is_empty;
+      index[i] = cc_hashmap_lookup(map, keys[base + i], &is_empty);
+      if (index[i] == (lmn_word)CC_PROB_FAIL || is_empty) {
+        index[i] = (lmn_word)CC_PROB_FAIL;
+      } else {
+        LMN_PREFETCH((void*)&map->data[index[i]], 0, 3);
+      }
+    }
+    for (int i = 0; i < m; i++) {
+      out[base + i] = (index[i] == (lmn_word)CC_PROB_FAIL) ? (lmn_data_t)CC_DOES_NOT_EXIST : map->data[index[i]];
+    }
+  }
+}
+
+/* probe sequences leaving the range of their partition are put afterwards, with CAS */
+void lmn_hashmap_bulk_load(lmn_hashmap_t *lmn_map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads) {
+  bulk_partition_t  p;
+  cc_hashmap_bulk_t b = { lmn_map->current, &p };
+  bulk_partition(&p, keys, values, n, lmn_map->current->bucket_mask, CC_LINE_SHIFT, nthreads);
+  RunParallel(nthreads, cc_hashmap_bulk_worker, &b);
+  bulk_put_deferred(&p, (hashmap_put_t)lmn_hashmap_put, lmn_map);
+  bulk_partition_free(&p);
+}
+
+/*
+ * A put publishes the key with one CAS and its value with a second one from
+ * the empty value. An update that finds the key before the value combines with
+ * the empty value and gets its CAS in first; the put then fails its CAS and
+ * behaves as a put of an existing key, which leaves the entry alone.
+ */
+lmn_data_t lmn_hashmap_update(lmn_hashmap_t *lmn_map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  cc_hashmap_t *map = lmn_map->current;
+  int is_empty;
+  lmn_word index;
+  for (;;) {
+    index = cc_hashmap_lookup(map, key, &is_empty);
+    if (LMN_UNLIKELY(index == (lmn_word)CC_PROB_FAIL)) {
+      fprintf(stderr, "full!!!!\n");
+      exit(1);
+    }
+    if (!is_empty || LMN_CAS(&map->buckets[index], CC_DOES_NOT_EXIST, key)) break;
+  }
+  for (;;) {
+    lmn_data_t old = map->data[index];
+    if (LMN_CAS(&map->data[index], old, combiner(old, arg))) return old;
+  }
+}
+
+void lmn_hashset_init(lmn_hashmap_t *lmn_map) {
+  lmn_map->current = lmn_malloc(cc_hashmap_t);
+  cc_hashset_init_inner(lmn_map->current, LMN_DEFAULT_SIZE);
+}
+
+int lmn_hashset_contains(lmn_hashmap_t *lmn_map, lmn_key_t key) {
+  int is_empty;
+  lmn_word index = cc_hashmap_lookup(lmn_map->current, key, &is_empty);
+  return index != (lmn_word)CC_PROB_FAIL && !is_empty;
+}
+
+/* a successful insert is a single CAS on the key line */
+int lmn_hashset_insert(lmn_hashmap_t *lmn_map, lmn_key_t key) {
+  cc_hashmap_t *map = lmn_map->current;
+  int is_empty;
+  for (;;) {
+    lmn_word index = cc_hashmap_lookup(map, key, &is_empty);
+    if (LMN_UNLIKELY(index == (lmn_word)CC_PROB_FAIL)) {
+      fprintf(stderr, "full!!!!\n");
+      exit(1);
+    }
+    if (!is_empty) return FALSE;
+    if (LMN_CAS(&map->buckets[index], CC_DOES_NOT_EXIST, key)) return TRUE;
+  }
+}
+
+lmn_word lmn_hashmap_slots(lmn_hashmap_t *lmn_map) {
+  return cc_hashmap_tbl_size(lmn_map->current);
+}
+
+/* set after init and before the first put: changing the policy moves where keys are looked up */
+void lmn_hashmap_set_probe(lmn_hashmap_t *lmn_map, int policy, double max_load) {
+  lmn_map->current->probe     = policy;
+  lmn_map->current->max_lines = cc_hashmap_probe_lines(max_load);
+}
+
+/* "linear", "quad" or "rehash"; -1 for anything else */
+int lmn_hashmap_probe_by_name(const char *name) {
+  if (strcmp(name, "linear") == 0) return CC_PROBE_LINEAR;
+  if (strcmp(name, "quad") == 0)   return CC_PROBE_QUADRATIC;
+  if (strcmp(name, "rehash") == 0) return CC_PROBE_REHASH;
+  return -1;
+}
+
+/* counts the lines every lookup probes, per thread */
+void lmn_hashmap_probe_stats(lmn_hashmap_t *lmn_map, int enable) {
+  cc_hashmap_t *map = lmn_map->current;
+  if (enable && map->probe_hist == NULL) {
+    map->probe_hist = lmn_calloc(lmn_word, LMN_MAX_THREADS * CC_PROBE_HIST);
+  } else if (!enable && map->probe_hist != NULL) {
+    lmn_word *hist = map->probe_hist;
+    map->probe_hist = NULL;
+    lmn_free(hist);
+  }
+}
+
+/* hist[i] = lookups that probed i + 1 lines (the last bucket includes failures) */
+void lmn_hashmap_probe_histogram(lmn_hashmap_t *lmn_map, lmn_word *hist) {
+  cc_hashmap_t *map = lmn_map->current;
+  memset(hist, 0x00, sizeof(lmn_word) * CC_PROBE_HIST);
+  if (map->probe_hist == NULL) return;
+  for (int t = 0; t < LMN_MAX_THREADS; t++) {
+    for (int i = 0; i < CC_PROBE_HIST; i++) {
+      hist[i] += map->probe_hist[t * CC_PROBE_HIST + i];
+    }
+  }
+}
+
+/*
+ * Since entries are never removed, a probe sequence that is full stays full:
+ * a key reported CC_TRY_FULL can never be stored in this table later on.
+ */
+int lmn_hashmap_try_find(lmn_hashmap_t *lmn_map, lmn_key_t key, lmn_data_t *data) {
+  cc_hashmap_t *map = lmn_map->current;
+  int is_empty;
+  lmn_word index = cc_hashmap_lookup(map, key, &is_empty);
+  if (index == (lmn_word)CC_PROB_FAIL) return CC_TRY_FULL;
+  if (is_empty) return CC_TRY_ABSENT;
+  LMN_PTR_VAL(data) = map->data[index];
+  return CC_TRY_FOUND;
+}
+
+int lmn_hashmap_try_put(lmn_hashmap_t *lmn_map, lmn_key_t key, lmn_data_t data) {
+  cc_hashmap_t *map = lmn_map->current;
+  int is_empty;
+  for (;;) {
+    lmn_word index = cc_hashmap_lookup(map, key, &is_empty);
+    if (index == (lmn_word)CC_PROB_FAIL) return CC_TRY_FULL;
+    if (!is_empty) return CC_TRY_FOUND;
+    if (LMN_CAS(&map->buckets[index], CC_DOES_NOT_EXIST, key)) {
+      return LMN_CAS(&map->data[index], (lmn_data_t)LMN_HASH_EMPTY_DATA, data) ? CC_TRY_INSERTED : CC_TRY_FOUND;
+    }
+  }
+}
+
+void lmn_hashmap_scan(lmn_hashmap_t *lmn_map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  cc_hashmap_t *map = lmn_map->current;
+  for (lmn_word i = begin; i < end; i++) {
+    lmn_key_t key = map->buckets[i];
+    if (key != CC_DOES_NOT_EXIST) {
+      fn(key, map->data[i], arg);
+    }
+  }
+}
+
+/* fill counts the keys of every cache line; begin and end are multiples of a line */
+void lmn_hashmap_stats(lmn_hashmap_t *lmn_map, lmn_word begin, lmn_word end, hashmap_stats_t *out) {
+  cc_hashmap_t *map = lmn_map->current;
+  out->allocated += (end - begin) * sizeof(lmn_key_t);
+  out->committed += lmn_table_committed((void*)&map->buckets[begin], (end - begin) * sizeof(lmn_key_t));
+  if (map->data != NULL) {
+    out->allocated += (end - begin) * sizeof(lmn_data_t);
+    out->committed += lmn_table_committed((void*)&map->data[begin], (end - begin) * sizeof(lmn_data_t));
+  }
+  for (lmn_word line = begin; line < end; line += CC_CACHE_LINE_SIZE_FOR_UNIT64) {
+    lmn_word used = 0;
+    for (lmn_word i = line; i < line + CC_CACHE_LINE_SIZE_FOR_UNIT64 && i < end; i++) {
+      lmn_key_t key = map->buckets[i];
+      if (key == CC_DOES_NOT_EXIST) continue;
+      hashmap_stats_record(out->distance, cc_hashmap_probe_distance(map, key, i));
+      used++;
+    }
+    hashmap_stats_record(out->fill, used);
+    out->entries += used;
+  }
+}
+
 }
 }
 }
@@ -17,11 +17,50 @@ namespace hashmap {
 
 #define CC_DOES_NOT_EXIST 0  // 000000...
 
+/* results of the non-exiting operations, for layers that handle a full probe sequence themselves */
+#define CC_TRY_FOUND    0
+#define CC_TRY_INSERTED 1
+#define CC_TRY_ABSENT   2
+#define CC_TRY_FULL     3
+
+/*
+ * Probe sequences. Every policy first walks the cache line holding the hashed
+ * slot; when the line is full it moves on to the next line (linear), to lines
+ * at triangular distances (quadratic), or to a line picked by rehashing (rehash).
+ * A lookup gives up after max_lines lines, which set_probe derives from the
+ * highest load factor the table is expected to reach. The compact map
+ * (cc_compact_hashmap.h) walks the same sequences over its denser lines.
+ */
+#define CC_PROBE_LINEAR        0
+#define CC_PROBE_QUADRATIC     1
+#define CC_PROBE_REHASH        2
+#define CC_PROBE_DEFAULT_LOAD  0.9
+#define CC_PROBE_MAX_LINES     1024
+#define CC_PROBE_HIST          32 // histogram buckets, the last one counts longer probes
+
+/* the line (as a slot offset) visited in round count + 1, for cache lines of entries slots */
+inline lmn_word cc_probe_next_line(int probe, lmn_word start, lmn_word offset, int count, lmn_word entries) {
+  switch (probe) {
+    case CC_PROBE_LINEAR:
+      return start + (lmn_word)(count + 1) * entries;
+    case CC_PROBE_QUADRATIC:
+      return start + (lmn_word)(count + 1) * (count + 2) / 2 * entries;
+    default:
+      return hash<lmn_word>(offset);
+  }
+}
+
+/* the probe length limit, in lines of entries slots, for tables filled up to max_load */
+int cc_probe_lines(double max_load, int entries);
+
 typedef struct _cc_hashmap_t {
   lmn_key_t   volatile *buckets; // key index array
   lmn_data_t  volatile *data; // data index array
   lmn_word    volatile bucket_mask;
   int         volatile *count;
+  int                   probe;
+  int                   max_lines;
+  lmn_word             *probe_hist; // LMN_MAX_THREADS x CC_PROBE_HIST lines probed per lookup, NULL when off
 } cc_hashmap_t;
 
 typedef struct _lmn_hashmap_t {
@@ -29,10 +68,28 @@ typedef struct _lmn_hashmap_t {
 } lmn_hashmap_t;
 
 void lmn_hashmap_init(lmn_hashmap_t *map);
+void lmn_hashmap_init_with_size(lmn_hashmap_t *map, lmn_word slots);
 lmn_data_t lmn_hashmap_find(lmn_hashmap_t *map, lmn_key_t key);
 void lmn_hashmap_put(lmn_hashmap_t *map, lmn_key_t key, lmn_data_t data);
 void lmn_hashmap_free(lmn_hashmap_t *map);
 int lmn_hashmap_count(lmn_hashmap_t *map);
+lmn_word lmn_hashmap_slots(lmn_hashmap_t *map);
+void lmn_hashmap_set_probe(lmn_hashmap_t *map, int policy, double max_load);
+int lmn_hashmap_probe_by_name(const char *name);
+void lmn_hashmap_probe_stats(lmn_hashmap_t *map, int enable);
+void lmn_hashmap_probe_histogram(lmn_hashmap_t *map, lmn_word *hist);
+void lmn_hashmap_find_batch(lmn_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+lmn_data_t lmn_hashmap_update(lmn_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg);
+void lmn_hashmap_bulk_load(lmn_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads);
+int lmn_hashmap_try_find(lmn_hashmap_t *map, lmn_key_t key, lmn_data_t *data);
+int lmn_hashmap_try_put(lmn_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+void lmn_hashmap_scan(lmn_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+void lmn_hashmap_stats(lmn_hashmap_t *map, lmn_word begin, lmn_word end, struct _hashmap_stats_t *out);
+
+/* the set specialization shares lmn_hashmap_t, with data left NULL */
+void lmn_hashset_init(lmn_hashmap_t *map);
+int lmn_hashset_contains(lmn_hashmap_t *map, lmn_key_t key);
+int lmn_hashset_insert(lmn_hashmap_t *map, lmn_key_t key);
 
 }
 }
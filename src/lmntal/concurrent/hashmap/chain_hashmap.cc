@@ -4,6 +4,9 @@
  * @author Taketo Yoshida
  */
 #include "chain_hashmap.h"
+#include "table_alloc.h"
+#include "bulk_load.h"
+#include "hashmap_stats.h"
 #include "../thread.h"
 
 namespace lmntal {
@@ -14,7 +17,7 @@ void chain_rehash(chain_hashmap_t *map) {
   int i;
   lmn_word                new_size = map->bucket_mask + 1;
   lmn_word                old_size = new_size;
-  chain_entry_t    **new_tbl = lmn_calloc(chain_entry_t*, new_size <<= 2);
+  chain_entry_t    **new_tbl = lmn_table_calloc(chain_entry_t*, new_size <<= 2);
   chain_entry_t    **old_tbl = map->tbl;
   chain_entry_t  *ent, *next;
   lmn_word               bucket;
@@ -34,65 +37,200 @@ void chain_rehash(chain_hashmap_t *map) {
 
   map->bucket_mask = new_bucket_mask;
   map->tbl         = new_tbl;
-  lmn_free(old_tbl);
+  lmn_table_free(old_tbl, chain_entry_t*, old_size);
 }
+/* finds and scans take a segment shared, which only the rw policy tells apart */
+template <typename L, bool shared>
+inline void chain_segment_acquire(chain_hashmap_t *map, int segment) {
+  if (shared) lmn_lock_acquire_shared(chain_segment_lock<L>(map, segment));
+  else        lmn_lock_acquire(chain_segment_lock<L>(map, segment));
+}
+
+template <typename L, bool shared>
+inline void chain_segment_release(chain_hashmap_t *map, int segment) {
+  if (shared) lmn_lock_release_shared(chain_segment_lock<L>(map, segment));
+  else        lmn_lock_release(chain_segment_lock<L>(map, segment));
+}
+
+template <typename L>
+void chain_resize_if_needed_with(chain_hashmap_t *map) {
+  if (map->size > map->bucket_mask * 0.75) {
+    if (!map->resize && LMN_CAS(&map->resize, 0, 1)) {
+      for(int i = 0; i < HASHMAP_SEGMENT; i++) {
+        lmn_lock_acquire(chain_segment_lock<L>(map, i));
+      }
+      chain_rehash(map);
+      for(int i = 0; i < HASHMAP_SEGMENT; i++) {
+        lmn_lock_release(chain_segment_lock<L>(map, i));
+      }
+      map->resize = 0;
+    }
+  }
+}
+
+/* locks the segment of key's bucket, following a concurrent rehash */
+template <typename L, bool shared>
+lmn_word chain_lock_bucket_with(chain_hashmap_t *map, lmn_key_t key) {
+  lmn_word bucket     = hash<lmn_word>(key) & map->bucket_mask;
+
+  chain_segment_acquire<L, shared>(map, bucket % HASHMAP_SEGMENT);
+  lmn_word new_bucket    = hash<lmn_word>(key) & map->bucket_mask;
+  if (new_bucket != bucket) {
+    chain_segment_release<L, shared>(map, bucket % HASHMAP_SEGMENT);
+    chain_segment_acquire<L, shared>(map, new_bucket % HASHMAP_SEGMENT);
+    bucket = new_bucket;
+  }
+  return bucket;
+}
+
+template <typename L>
+void chain_init_locks(chain_hashmap_t *map) {
+  if (posix_memalign(&map->locks, LMN_CACHE_LINE_SIZE, sizeof(L) * HASHMAP_SEGMENT) != 0) {
+    fprintf(stderr, "failed to allocate segment locks\n");
+    exit(1);
+  }
+  for (int i = 0; i < HASHMAP_SEGMENT; i++) {
+    lmn_lock_init(chain_segment_lock<L>(map, i));
+  }
+}
+
+template <typename L>
+void chain_free_with(chain_hashmap_t *map) {
+  for (int i = 0; i < HASHMAP_SEGMENT; i++) {
+    lmn_lock_destroy(chain_segment_lock<L>(map, i));
+  }
+  lmn_free(map->locks);
+  map->locks = NULL;
+}
+
+template <typename L>
+lmn_data_t chain_find_with(chain_hashmap_t *map, lmn_key_t key) {
+  lmn_word bucket     = chain_lock_bucket_with<L, true>(map, key);
+  lmn_data_t data     = chain_find_locked(map, bucket, key);
+  chain_segment_release<L, true>(map, bucket % HASHMAP_SEGMENT);
+  return data;
+}
+
+template <typename L>
+void chain_put_with(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  lmn_word bucket        = chain_lock_bucket_with<L, false>(map, key);
+  chain_put_locked(map, bucket, key, data);
+  chain_segment_release<L, false>(map, bucket % HASHMAP_SEGMENT);
+  chain_resize_if_needed_with<L>(map);
+}
+
+template <typename L>
+lmn_data_t chain_update_with(chain_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  lmn_word bucket = chain_lock_bucket_with<L, false>(map, key);
+  lmn_data_t  old = chain_find_locked(map, bucket, key);
+  chain_put_locked(map, bucket, key, combiner(old, arg));
+  chain_segment_release<L, false>(map, bucket % HASHMAP_SEGMENT);
+  chain_resize_if_needed_with<L>(map);
+  return old;
+}
+
 /*
- * public functions
+ * The range is walked one segment at a time, so a chunk costs
+ * HASHMAP_SEGMENT lock round trips instead of one per bucket. A rehash
+ * replaces the table under all segment locks; the rest of this chunk is then
+ * skipped, and later chunks walk the new table over the slot range the scan
+ * started with, so entries can be missed or reported twice (see hashmap.h).
+ */
+template <typename L>
+void chain_scan_with(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  chain_entry_t **tbl = map->tbl;
+  for (int s = 0; s < HASHMAP_SEGMENT; s++) {
+    chain_segment_acquire<L, true>(map, s);
+    if (map->tbl == tbl) {
+      lmn_word i = begin + (s + HASHMAP_SEGMENT - begin % HASHMAP_SEGMENT) % HASHMAP_SEGMENT;
+      for (; i < end; i += HASHMAP_SEGMENT) {
+        for (chain_entry_t *ent = tbl[i]; ent != LMN_HASH_EMPTY; ent = ent->next) {
+          fn(ent->key, ent->data, arg);
+        }
+      }
+    }
+    chain_segment_release<L, true>(map, s);
+  }
+}
+
+/*
+ * public functions; the plain entry points are the mutex instantiations, which
+ * is what chain_init sets up and what the flat-combining map shares
  */
 
 void chain_init(chain_hashmap_t* map) {
-  map->tbl              = (chain_entry_t**)calloc(sizeof(chain_entry_t*), LMN_DEFAULT_SIZE);
+  chain_init_with_lock(map, LMN_LOCK_MUTEX);
+}
+
+void chain_init_with_lock(chain_hashmap_t* map, int policy) {
+  map->tbl              = lmn_table_calloc(chain_entry_t*, LMN_DEFAULT_SIZE);
   map->bucket_mask      = LMN_DEFAULT_SIZE- 1;
   map->size             = 0;
-  memset(map->tbl, 0x00, LMN_DEFAULT_SIZE);
-  {
-    pthread_mutexattr_t mattr[HASHMAP_SEGMENT];
-    int i;
-    for (i = 0; i < HASHMAP_SEGMENT; i++) {
-      pthread_mutexattr_init(&mattr[i]);
-      pthread_mutexattr_setpshared(&mattr[i], PTHREAD_PROCESS_SHARED);
-      pthread_mutex_init(&map->mutexs[i], &mattr[i]);
-    }
+  map->resize           = 0;
+  map->lock_policy      = policy;
+  switch (policy) {
+    case LMN_LOCK_MUTEX:  chain_init_locks<lmn_mutex_lock_t>(map);  break;
+    case LMN_LOCK_TTAS:   chain_init_locks<lmn_ttas_lock_t>(map);   break;
+    case LMN_LOCK_TICKET: chain_init_locks<lmn_ticket_lock_t>(map); break;
+    case LMN_LOCK_MCS:    chain_init_locks<lmn_mcs_lock_t>(map);    break;
+    case LMN_LOCK_RW:     chain_init_locks<lmn_rw_spinlock_t>(map); break;
+    default:
+      fprintf(stderr, "unknown lock policy: %d\n", policy);
+      exit(1);
   }
 }
 
 void chain_free(chain_hashmap_t* map) {
-
+  switch (map->lock_policy) {
+    case LMN_LOCK_MUTEX:  chain_free_with<lmn_mutex_lock_t>(map);  break;
+    case LMN_LOCK_TTAS:   chain_free_with<lmn_ttas_lock_t>(map);   break;
+    case LMN_LOCK_TICKET: chain_free_with<lmn_ticket_lock_t>(map); break;
+    case LMN_LOCK_MCS:    chain_free_with<lmn_mcs_lock_t>(map);    break;
+    case LMN_LOCK_RW:     chain_free_with<lmn_rw_spinlock_t>(map); break;
+  }
 }
 
 lmn_data_t chain_find(chain_hashmap_t *map, lmn_key_t key) {
-  lmn_word bucket     = hash<lmn_word>(key) & map->bucket_mask;
+  return chain_find_with<lmn_mutex_lock_t>(map, key);
+}
 
-  pthread_mutex_lock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
-  lmn_word new_bucket    = hash<lmn_word>(key) & map->bucket_mask;
-  if (new_bucket != bucket) {
-    pthread_mutex_unlock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
-    pthread_mutex_lock(&map->mutexs[new_bucket % HASHMAP_SEGMENT]);
-    bucket = new_bucket;
-  }
+void chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  chain_put_with<lmn_mutex_lock_t>(map, key, data);
+}
+
+/* also serves the flat-combining map, whose combiners hold the same segment locks */
+lmn_data_t chain_update(chain_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  return chain_update_with<lmn_mutex_lock_t>(map, key, combiner, arg);
+}
+
+lmn_word chain_lock_bucket(chain_hashmap_t *map, lmn_key_t key) {
+  return chain_lock_bucket_with<lmn_mutex_lock_t, false>(map, key);
+}
+
+void chain_resize_if_needed(chain_hashmap_t *map) {
+  chain_resize_if_needed_with<lmn_mutex_lock_t>(map);
+}
+
+void chain_scan(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  chain_scan_with<lmn_mutex_lock_t>(map, begin, end, fn, arg);
+}
+
+/* the caller holds the segment lock of bucket */
+lmn_data_t chain_find_locked(chain_hashmap_t *map, lmn_word bucket, lmn_key_t key) {
   chain_entry_t *ent  = map->tbl[bucket];
   while(ent != LMN_HASH_EMPTY) {
     if (ent->key == key) {
-      pthread_mutex_unlock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
       return ent->data;
     }
     ent = ent->next;
   }
-  pthread_mutex_unlock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
   return NULL;
 }
 
-void chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
-  lmn_word bucket        = hash<lmn_word>(key) & map->bucket_mask;
+/* the caller holds the segment lock of bucket and checks for a resize after unlocking */
+void chain_put_locked(chain_hashmap_t *map, lmn_word bucket, lmn_key_t key, lmn_data_t data) {
   chain_entry_t *cur, *tmp;
 
-  pthread_mutex_lock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
-  lmn_word new_bucket    = hash<lmn_word>(key) & map->bucket_mask;
-  if (new_bucket != bucket) {
-    pthread_mutex_unlock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
-    pthread_mutex_lock(&map->mutexs[new_bucket % HASHMAP_SEGMENT]);
-    bucket = new_bucket;
-  }
   chain_entry_t **ent    = &map->tbl[bucket];
   if ((*ent) == LMN_HASH_EMPTY) {
     (*ent) = lmn_malloc(chain_entry_t);
@@ -103,7 +241,6 @@ void chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
     do {
       if (cur->key == key) {
         cur->data = data;
-        pthread_mutex_unlock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
         return;
       }
       //printf("%p ", cur->next);
@@ -116,21 +253,260 @@ void chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
   (*ent)->key  = key;
   (*ent)->data = data;
   LMN_ATOMIC_ADD(&map->size, 1);
-  pthread_mutex_unlock(&map->mutexs[bucket % HASHMAP_SEGMENT]);
-  if (map->size > map->bucket_mask * 0.75) {
-    if (!map->resize && LMN_CAS(&map->resize, 0, 1)) {
-      for(int i = 0; i < HASHMAP_SEGMENT; i++) {
-        pthread_mutex_lock(&map->mutexs[i]);
+}
+
+lmn_word chain_slots(chain_hashmap_t *map) {
+  return map->bucket_mask + 1;
+}
+
+/* walks one chain into the fill (length) and distance (position) histograms */
+void chain_stats_bucket(chain_entry_t *ent, hashmap_stats_t *out) {
+  lmn_word n = 0;
+  for (; ent != LMN_HASH_EMPTY; ent = ent->next) {
+    hashmap_stats_record(out->distance, n++);
+  }
+  hashmap_stats_record(out->fill, n);
+  out->entries   += n;
+  out->allocated += n * sizeof(chain_entry_t);
+  out->committed += n * sizeof(chain_entry_t);
+}
+
+/* segments are visited like in chain_scan, under shared segment locks */
+template <typename L>
+void chain_stats_with(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_stats_t *out) {
+  chain_entry_t **tbl = map->tbl;
+  out->allocated += (end - begin) * sizeof(chain_entry_t*);
+  out->committed += lmn_table_committed(&tbl[begin], (end - begin) * sizeof(chain_entry_t*));
+  for (int s = 0; s < HASHMAP_SEGMENT; s++) {
+    chain_segment_acquire<L, true>(map, s);
+    if (map->tbl == tbl) {
+      lmn_word i = begin + (s + HASHMAP_SEGMENT - begin % HASHMAP_SEGMENT) % HASHMAP_SEGMENT;
+      for (; i < end; i += HASHMAP_SEGMENT) {
+        chain_stats_bucket(tbl[i], out);
       }
-      chain_rehash(map);
-      for(int i = 0; i < HASHMAP_SEGMENT; i++) {
-        pthread_mutex_unlock(&map->mutexs[i]);
+    }
+    chain_segment_release<L, true>(map, s);
+  }
+}
+
+void chain_stats(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_stats_t *out) {
+  chain_stats_with<lmn_mutex_lock_t>(map, begin, end, out);
+}
+
+/*
+ * Batched lookups run as CHAIN_BATCH_GROUP interleaved tasks. A step of a task
+ * touches one bucket slot or node and prefetches the next one, then yields to
+ * the next task, so the dependent misses of different chains overlap. A task
+ * that finishes is refilled with the next key. With sorted chains a miss ends
+ * at the first larger key.
+ */
+typedef struct {
+  chain_entry_t * volatile *slot; // bucket slot still to be read, NULL once at the nodes
+  chain_entry_t            *cur;
+  lmn_key_t                 key;
+  int                       index;
+} chain_task_t;
+
+inline void chain_task_start(chain_task_t *t, chain_entry_t **tbl, lmn_word mask, const lmn_key_t *keys, int index) {
+  t->key   = keys[index];
+  t->index = index;
+  t->slot  = &tbl[hash<lmn_word>(t->key) & mask];
+  LMN_PREFETCH((void*)t->slot, 0, 3);
+}
+
+void chain_find_interleaved(chain_entry_t **tbl, lmn_word mask, const lmn_key_t *keys, lmn_data_t *out, int n, int sorted) {
+  chain_task_t tasks[CHAIN_BATCH_GROUP];
+  int live = 0, next = 0;
+  while (live < CHAIN_BATCH_GROUP && next < n) {
+    chain_task_start(&tasks[live++], tbl, mask, keys, next++);
+  }
+  while (live > 0) {
+    for (int i = 0; i < live; ) {
+      chain_task_t *t = &tasks[i];
+      if (t->slot != NULL) {
+        t->cur  = *t->slot;
+        t->slot = NULL;
+        LMN_PREFETCH(t->cur, 0, 3);
+        i++;
+        continue;
       }
-      map->resize = 0;
+      chain_entry_t *ent = t->cur;
+      if (ent != LMN_HASH_EMPTY && ent->key != t->key && !(sorted && ent->key > t->key)) {
+        t->cur = ent->next;
+        LMN_PREFETCH(t->cur, 0, 3);
+        i++;
+        continue;
+      }
+      out[t->index] = (ent != LMN_HASH_EMPTY && ent->key == t->key) ? ent->data : NULL;
+      if (next < n) {
+        chain_task_start(t, tbl, mask, keys, next++);
+        i++;
+      } else {
+        tasks[i] = tasks[--live];
+      }
+    }
+  }
+}
+
+/*
+ * Each group of keys takes the segment locks it needs in ascending order,
+ * the order the rehash takes them in as well, and is then walked interleaved.
+ * Holding any segment lock keeps the table from being replaced, so the group
+ * only has to start over when a rehash slipped in before the locks were taken.
+ */
+template <typename L>
+void chain_find_batch_with(chain_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  for (int base = 0; base < n; base += CHAIN_BATCH_GROUP) {
+    int m = (n - base < CHAIN_BATCH_GROUP) ? n - base : CHAIN_BATCH_GROUP;
+    for (;;) {
+      chain_entry_t **tbl  = map->tbl;
+      lmn_word        mask = map->bucket_mask;
+      int         segments = 0;
+      for (int i = 0; i < m; i++) {
+        segments |= 1 << ((hash<lmn_word>(keys[base + i]) & mask) % HASHMAP_SEGMENT);
+      }
+      for (int s = 0; s < HASHMAP_SEGMENT; s++) {
+        if (segments & (1 << s)) chain_segment_acquire<L, true>(map, s);
+      }
+      int stable = (map->tbl == tbl && map->bucket_mask == mask);
+      if (stable) chain_find_interleaved(tbl, mask, keys + base, out + base, m, FALSE);
+      for (int s = 0; s < HASHMAP_SEGMENT; s++) {
+        if (segments & (1 << s)) chain_segment_release<L, true>(map, s);
+      }
+      if (stable) break;
     }
   }
 }
 
+void chain_find_batch(chain_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  chain_find_batch_with<lmn_mutex_lock_t>(map, keys, out, n);
+}
+
+typedef struct {
+  chain_hashmap_t  *map;
+  bulk_partition_t *p;
+} chain_bulk_t;
+
+/* the nodes of a partition come out of one block, which is never freed like any other node */
+void chain_bulk_worker(int index, int nthreads, void *arg) {
+  chain_bulk_t     *b     = (chain_bulk_t*)arg;
+  bulk_partition_t *p     = b->p;
+  lmn_word          added = 0;
+  int part;
+  while ((part = bulk_next_partition(p)) >= 0) {
+    lmn_word begin = p->parts[part], end = p->parts[part + 1];
+    if (begin == end) continue;
+    chain_entry_t *block = lmn_calloc(chain_entry_t, end - begin);
+    lmn_word       used  = 0;
+    for (lmn_word i = begin; i < end; i++) {
+      chain_entry_t **head = &b->map->tbl[bulk_bucket(p, p->keys[i])];
+      chain_entry_t  *ent  = *head;
+      while (ent != LMN_HASH_EMPTY && ent->key != p->keys[i]) {
+        ent = ent->next;
+      }
+      if (ent == LMN_HASH_EMPTY) {
+        ent       = &block[used++];
+        ent->key  = p->keys[i];
+        ent->next = *head;
+        *head     = ent;
+      }
+      ent->data = p->values[i];
+    }
+    if (used == 0) lmn_free(block);
+    added += used;
+  }
+  LMN_ATOMIC_ADD(&b->map->size, added);
+}
+
+/* the table is grown up front, so the load never has to rehash */
+void chain_bulk_load(chain_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads) {
+  while (map->size + n > map->bucket_mask * 0.75) {
+    chain_rehash(map);
+  }
+  bulk_partition_t p;
+  chain_bulk_t     b = { map, &p };
+  bulk_partition(&p, keys, values, n, map->bucket_mask, 0, nthreads);
+  RunParallel(nthreads, chain_bulk_worker, &b);
+  bulk_partition_free(&p);
+}
+
+/*
+ * keys-only tables are always built by chain_init, so they use the mutex policy
+ */
+
+int chain_set_contains(chain_hashmap_t *map, lmn_key_t key) {
+  lmn_word bucket = chain_lock_bucket_with<lmn_mutex_lock_t, true>(map, key);
+  chain_set_entry_t *ent = (chain_set_entry_t*)map->tbl[bucket];
+  while (ent != LMN_HASH_EMPTY && ent->key != key) {
+    ent = ent->next;
+  }
+  chain_segment_release<lmn_mutex_lock_t, true>(map, bucket % HASHMAP_SEGMENT);
+  return ent != LMN_HASH_EMPTY;
+}
+
+int chain_set_insert(chain_hashmap_t *map, lmn_key_t key) {
+  lmn_word bucket = chain_lock_bucket(map, key);
+  chain_set_entry_t **head = (chain_set_entry_t**)&map->tbl[bucket];
+  for (chain_set_entry_t *ent = *head; ent != LMN_HASH_EMPTY; ent = ent->next) {
+    if (ent->key == key) {
+      lmn_lock_release(chain_segment_lock<lmn_mutex_lock_t>(map, bucket % HASHMAP_SEGMENT));
+      return FALSE;
+    }
+  }
+  chain_set_entry_t *ent = lmn_malloc(chain_set_entry_t);
+  ent->key  = key;
+  ent->next = *head;
+  *head     = ent;
+  LMN_ATOMIC_ADD(&map->size, 1);
+  lmn_lock_release(chain_segment_lock<lmn_mutex_lock_t>(map, bucket % HASHMAP_SEGMENT));
+  chain_resize_if_needed(map);
+  return TRUE;
+}
+
+/* init of the impl table of a policy, so that maps built through it get matching locks */
+template <int policy>
+void chain_init_with(chain_hashmap_t *map) {
+  chain_init_with_lock(map, policy);
+}
+
+template <typename L, int policy>
+const hashmap_impl_t *chain_impl_for() {
+  static const hashmap_impl_t impl = {
+    (hashmap_find_t)chain_find_with<L>,
+    (hashmap_put_t)chain_put_with<L>,
+    (hashmap_init_t)chain_init_with<policy>,
+    (hashmap_free_t)chain_free,
+    (hashmap_slots_t)chain_slots,
+    (hashmap_scan_t)chain_scan_with<L>,
+    (hashmap_find_batch_t)chain_find_batch_with<L>,
+    (hashmap_bulk_load_t)chain_bulk_load,
+    (hashmap_update_t)chain_update_with<L>,
+    (hashmap_stats_range_t)chain_stats_with<L>,
+  };
+  return &impl;
+}
+
+/* the operations of a map built by chain_init_with_lock(map, policy) */
+const hashmap_impl_t *chain_impl_with_lock(int policy) {
+  switch (policy) {
+    case LMN_LOCK_MUTEX:  return chain_impl_for<lmn_mutex_lock_t, LMN_LOCK_MUTEX>();
+    case LMN_LOCK_TTAS:   return chain_impl_for<lmn_ttas_lock_t, LMN_LOCK_TTAS>();
+    case LMN_LOCK_TICKET: return chain_impl_for<lmn_ticket_lock_t, LMN_LOCK_TICKET>();
+    case LMN_LOCK_MCS:    return chain_impl_for<lmn_mcs_lock_t, LMN_LOCK_MCS>();
+    case LMN_LOCK_RW:     return chain_impl_for<lmn_rw_spinlock_t, LMN_LOCK_RW>();
+  }
+  fprintf(stderr, "unknown lock policy: %d\n", policy);
+  exit(1);
+}
+
+int chain_lock_policy_by_name(const char *name) {
+  static const char *names[] = { "mutex", "ttas", "ticket", "mcs", "rw" };
+  for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+    if (strcmp(name, names[i]) == 0) return i;
+  }
+  return -1;
+}
+
 }
 }
 }
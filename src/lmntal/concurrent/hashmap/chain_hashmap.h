@@ -7,25 +7,40 @@
 #  define CHAIN_HASHMAP_H
 
 #include "hashmap.h"
+#include "segment_lock.h"
 
 namespace lmntal {
 namespace concurrent {
 namespace hashmap {
 
+/* key and next lead so that set nodes are a prefix of map nodes and share the rehash */
 typedef struct _chain_entry_t {
   lmn_word               volatile key;
-  lmn_data_t             volatile data;
   struct _chain_entry_t* volatile next;
+  lmn_data_t             volatile data;
 } chain_entry_t;
 
+typedef struct _chain_set_entry_t {
+  lmn_word                   volatile key;
+  struct _chain_set_entry_t* volatile next;
+} chain_set_entry_t;
+
+#define CHAIN_BATCH_GROUP 8 // lookups in flight at once
+
 typedef struct {
   lmn_word         volatile bucket_mask;
   lmn_word         volatile size;
   chain_entry_t**  volatile tbl;
   int              volatile resize;
-  pthread_mutex_t        mutexs[HASHMAP_SEGMENT];
+  void                  *locks;       // HASHMAP_SEGMENT segment locks of lock_policy, one cache line each
+  int                    lock_policy; // lmn_lock_policy_t
 } chain_hashmap_t;
 
+template <typename L>
+inline L *chain_segment_lock(chain_hashmap_t *map, int segment) {
+  return &((L*)map->locks)[segment];
+}
+
 typedef struct {
   lmn_word         volatile bucket_mask;
   lmn_word         volatile size;
@@ -33,9 +48,27 @@ typedef struct {
 } lf_chain_hashmap_t;
 
 void chain_init(chain_hashmap_t* map);
+void chain_init_with_lock(chain_hashmap_t* map, int policy);
+const hashmap_impl_t *chain_impl_with_lock(int policy);
+int chain_lock_policy_by_name(const char *name);
 lmn_data_t chain_find(chain_hashmap_t *map, lmn_key_t key);
 void chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data);
 void chain_free(chain_hashmap_t* map);
+lmn_data_t chain_update(chain_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg);
+lmn_word chain_lock_bucket(chain_hashmap_t *map, lmn_key_t key);
+lmn_data_t chain_find_locked(chain_hashmap_t *map, lmn_word bucket, lmn_key_t key);
+void chain_put_locked(chain_hashmap_t *map, lmn_word bucket, lmn_key_t key, lmn_data_t data);
+void chain_resize_if_needed(chain_hashmap_t *map);
+lmn_word chain_slots(chain_hashmap_t *map);
+void chain_scan(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+void chain_find_batch(chain_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+void chain_bulk_load(chain_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads);
+void chain_stats(chain_hashmap_t *map, lmn_word begin, lmn_word end, struct _hashmap_stats_t *out);
+void chain_stats_bucket(chain_entry_t *ent, struct _hashmap_stats_t *out);
+void chain_find_interleaved(chain_entry_t **tbl, lmn_word mask, const lmn_key_t *keys, lmn_data_t *out, int n, int sorted);
+
+int chain_set_contains(chain_hashmap_t *map, lmn_key_t key);
+int chain_set_insert(chain_hashmap_t *map, lmn_key_t key);
 
 }
 }
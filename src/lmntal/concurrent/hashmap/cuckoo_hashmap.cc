@@ -0,0 +1,341 @@
+/**
+ * @file   cuckoo_hashmap.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "cuckoo_hashmap.h"
+#include "table_alloc.h"
+#include "bulk_load.h"
+#include "hashmap_stats.h"
+#include "../thread.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define CUCKOO_SALT        0x9e3779b97f4a7c15ULL
+#define CUCKOO_MAX_DEPTH   7
+#define CUCKOO_MAX_BFS     4096
+#define CUCKOO_MAX_RETRY   64
+#define CUCKOO_SLOT_NONE   -1
+#define CUCKOO_BATCH_GROUP 16
+
+typedef struct {
+  lmn_word bucket;
+  int      parent; // bfs entry whose key moves into this bucket
+  int      slot;   // slot of that key in the parent bucket
+  int      depth;
+} cuckoo_bfs_entry_t;
+
+/*
+ * private functions
+ */
+
+inline lmn_word cuckoo_bucket1(cuckoo_hashmap_t *map, lmn_key_t key) {
+  return hash<lmn_word>(key) & map->bucket_mask;
+}
+
+inline lmn_word cuckoo_bucket2(cuckoo_hashmap_t *map, lmn_key_t key) {
+  lmn_word b1 = cuckoo_bucket1(map, key);
+  lmn_word b2 = hash<lmn_word>(key ^ CUCKOO_SALT) & map->bucket_mask;
+  return (b1 == b2) ? ((b1 + 1) & map->bucket_mask) : b2;
+}
+
+inline lmn_word cuckoo_alt_bucket(cuckoo_hashmap_t *map, lmn_key_t key, lmn_word bucket) {
+  lmn_word b1 = cuckoo_bucket1(map, key);
+  return (bucket == b1) ? cuckoo_bucket2(map, key) : b1;
+}
+
+inline lmn_word cuckoo_read_version(cuckoo_bucket_t *b) {
+  lmn_word v;
+  while ((v = b->version) & 1) {
+    LMN_CPU_RELAX();
+  }
+  LMN_COMPILER_BARRIER();
+  return v;
+}
+
+inline void cuckoo_lock(cuckoo_bucket_t *b) {
+  for (;;) {
+    lmn_word v = b->version;
+    if (!(v & 1) && LMN_CAS(&b->version, v, v + 1)) return;
+    LMN_CPU_RELAX();
+  }
+}
+
+inline void cuckoo_unlock(cuckoo_bucket_t *b) {
+  LMN_COMPILER_BARRIER();
+  b->version = b->version + 1;
+}
+
+/* buckets are always locked in index order, so two writers can not deadlock */
+inline void cuckoo_lock2(cuckoo_hashmap_t *map, lmn_word b1, lmn_word b2) {
+  if (b1 == b2) {
+    cuckoo_lock(&map->buckets[b1]);
+  } else if (b1 < b2) {
+    cuckoo_lock(&map->buckets[b1]);
+    cuckoo_lock(&map->buckets[b2]);
+  } else {
+    cuckoo_lock(&map->buckets[b2]);
+    cuckoo_lock(&map->buckets[b1]);
+  }
+}
+
+inline void cuckoo_unlock2(cuckoo_hashmap_t *map, lmn_word b1, lmn_word b2) {
+  cuckoo_unlock(&map->buckets[b1]);
+  if (b1 != b2) cuckoo_unlock(&map->buckets[b2]);
+}
+
+inline int cuckoo_find_slot(cuckoo_bucket_t *b, lmn_key_t key) {
+  for (int i = 0; i < CUCKOO_SLOTS; i++) {
+    if (b->keys[i] == key) return i;
+  }
+  return CUCKOO_SLOT_NONE;
+}
+
+/*
+ * Looks for a chain of displacements, breadth first and without locks, that
+ * ends in a bucket with a free slot, then executes it backwards so that every
+ * single move has a free destination. Each move locks its two buckets and
+ * rechecks the key it displaces; if another writer got in the way the put
+ * simply retries. Returns FALSE when no free slot is within reach.
+ */
+int cuckoo_make_room(cuckoo_hashmap_t *map, lmn_word b1, lmn_word b2) {
+  cuckoo_bfs_entry_t queue[CUCKOO_MAX_BFS];
+  int head = 0, tail = 0, found = -1;
+
+  queue[tail].bucket = b1; queue[tail].parent = -1; queue[tail].slot = 0; queue[tail].depth = 0; tail++;
+  queue[tail].bucket = b2; queue[tail].parent = -1; queue[tail].slot = 0; queue[tail].depth = 0; tail++;
+  while (head < tail) {
+    cuckoo_bfs_entry_t *e = &queue[head];
+    cuckoo_bucket_t    *b = &map->buckets[e->bucket];
+    if (cuckoo_find_slot(b, LMN_HASH_EMPTY_KEY) != CUCKOO_SLOT_NONE) {
+      found = head;
+      break;
+    }
+    if (e->depth < CUCKOO_MAX_DEPTH) {
+      for (int i = 0; i < CUCKOO_SLOTS && tail < CUCKOO_MAX_BFS; i++) {
+        lmn_key_t key = b->keys[i];
+        if (key == LMN_HASH_EMPTY_KEY) continue;
+        queue[tail].bucket = cuckoo_alt_bucket(map, key, e->bucket);
+        LMN_PREFETCH(&map->buckets[queue[tail].bucket], 0, 3);
+        queue[tail].parent = head;
+        queue[tail].slot   = i;
+        queue[tail].depth  = e->depth + 1;
+        tail++;
+      }
+    }
+    head++;
+  }
+  if (found < 0) return FALSE;
+
+  for (int cur = found; queue[cur].parent >= 0; cur = queue[cur].parent) {
+    cuckoo_bfs_entry_t *to   = &queue[cur];
+    cuckoo_bfs_entry_t *from = &queue[to->parent];
+    cuckoo_bucket_t    *src  = &map->buckets[from->bucket];
+    cuckoo_bucket_t    *dst  = &map->buckets[to->bucket];
+
+    cuckoo_lock2(map, from->bucket, to->bucket);
+    lmn_key_t key = src->keys[to->slot];
+    int free_slot = cuckoo_find_slot(dst, LMN_HASH_EMPTY_KEY);
+    if (key == LMN_HASH_EMPTY_KEY || free_slot == CUCKOO_SLOT_NONE ||
+        cuckoo_alt_bucket(map, key, from->bucket) != to->bucket) {
+      cuckoo_unlock2(map, from->bucket, to->bucket);
+      return TRUE;
+    }
+    dst->data[free_slot]    = src->data[to->slot];
+    dst->keys[free_slot]    = key;
+    src->keys[to->slot]     = LMN_HASH_EMPTY_KEY;
+    src->data[to->slot]     = LMN_HASH_EMPTY_DATA;
+    cuckoo_unlock2(map, from->bucket, to->bucket);
+  }
+  return TRUE;
+}
+
+typedef struct {
+  cuckoo_hashmap_t *map;
+  bulk_partition_t *p;
+} cuckoo_bulk_t;
+
+/*
+ * Keys only go into their first bucket, which the partition owns. The second
+ * bucket may belong to another thread, but during the load that thread only
+ * stores keys whose first bucket it is, so reading it can not miss this key.
+ */
+inline int cuckoo_bulk_place(cuckoo_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  if (key == LMN_HASH_EMPTY_KEY) return FALSE;
+  cuckoo_bucket_t *b1 = &map->buckets[cuckoo_bucket1(map, key)];
+  int i;
+  if ((i = cuckoo_find_slot(b1, key)) != CUCKOO_SLOT_NONE) {
+    b1->data[i] = data;
+    return TRUE;
+  }
+  if (cuckoo_find_slot(&map->buckets[cuckoo_bucket2(map, key)], key) != CUCKOO_SLOT_NONE) return FALSE;
+  if ((i = cuckoo_find_slot(b1, LMN_HASH_EMPTY_KEY)) == CUCKOO_SLOT_NONE) return FALSE;
+  b1->data[i] = data;
+  b1->keys[i] = key;
+  return TRUE;
+}
+
+void cuckoo_bulk_worker(int index, int nthreads, void *arg) {
+  cuckoo_bulk_t    *b = (cuckoo_bulk_t*)arg;
+  bulk_partition_t *p = b->p;
+  int part;
+  while ((part = bulk_next_partition(p)) >= 0) {
+    for (lmn_word i = p->parts[part]; i < p->parts[part + 1]; i++) {
+      if (!cuckoo_bulk_place(b->map, p->keys[i], p->values[i])) bulk_defer(p, index, i);
+    }
+  }
+}
+
+/*
+ * public functions
+ */
+
+void cuckoo_init(cuckoo_hashmap_t *map) {
+  cuckoo_init_with_size(map, LMN_DEFAULT_SIZE >> 2);
+}
+
+/* nbuckets must be a power of two */
+void cuckoo_init_with_size(cuckoo_hashmap_t *map, lmn_word nbuckets) {
+  map->raw         = lmn_table_calloc(cuckoo_bucket_t, nbuckets + 1);
+  map->buckets     = (cuckoo_bucket_t*)(((lmn_word)map->raw + LMN_CACHE_LINE_SIZE - 1) & ~(lmn_word)(LMN_CACHE_LINE_SIZE - 1));
+  map->bucket_mask = nbuckets - 1;
+}
+
+/* key 0 marks an empty slot, so it is never stored */
+lmn_data_t cuckoo_find(cuckoo_hashmap_t *map, lmn_key_t key) {
+  if (LMN_UNLIKELY(key == LMN_HASH_EMPTY_KEY)) return LMN_HASH_EMPTY_DATA;
+  cuckoo_bucket_t *b1 = &map->buckets[cuckoo_bucket1(map, key)];
+  cuckoo_bucket_t *b2 = &map->buckets[cuckoo_bucket2(map, key)];
+  LMN_PREFETCH(b2, 0, 3);
+  for (;;) {
+    lmn_word   v1   = cuckoo_read_version(b1);
+    lmn_word   v2   = cuckoo_read_version(b2);
+    lmn_data_t data = LMN_HASH_EMPTY_DATA;
+    int i;
+    if ((i = cuckoo_find_slot(b1, key)) != CUCKOO_SLOT_NONE) {
+      data = b1->data[i];
+    } else if ((i = cuckoo_find_slot(b2, key)) != CUCKOO_SLOT_NONE) {
+      data = b2->data[i];
+    }
+    LMN_COMPILER_BARRIER();
+    if (b1->version == v1 && b2->version == v2) return data;
+  }
+}
+
+/* both buckets of every key in a group are prefetched before the first lookup */
+void cuckoo_find_batch(cuckoo_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  for (int base = 0; base < n; base += CUCKOO_BATCH_GROUP) {
+    int m = (n - base < CUCKOO_BATCH_GROUP) ? n - base : CUCKOO_BATCH_GROUP;
+    for (int i = 0; i < m; i++) {
+      LMN_PREFETCH(&map->buckets[cuckoo_bucket1(map, keys[base + i])], 0, 3);
+      LMN_PREFETCH(&map->buckets[cuckoo_bucket2(map, keys[base + i])], 0, 3);
+    }
+    for (int i = 0; i < m; i++) {
+      out[base + i] = cuckoo_find(map, keys[base + i]);
+    }
+  }
+}
+
+void cuckoo_put(cuckoo_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  cuckoo_update(map, key, hashmap_combine_set, data);
+}
+
+/* both buckets stay locked from reading the old value to storing the new one */
+lmn_data_t cuckoo_update(cuckoo_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  if (LMN_UNLIKELY(key == LMN_HASH_EMPTY_KEY)) {
+    fprintf(stderr, "invalid key %lu, it marks an empty slot\n", key);
+    exit(1);
+  }
+  lmn_word i1 = cuckoo_bucket1(map, key);
+  lmn_word i2 = cuckoo_bucket2(map, key);
+  cuckoo_bucket_t *b1 = &map->buckets[i1];
+  cuckoo_bucket_t *b2 = &map->buckets[i2];
+
+  for (int retry = 0; retry < CUCKOO_MAX_RETRY; retry++) {
+    int i;
+    lmn_data_t old = LMN_HASH_EMPTY_DATA;
+    cuckoo_lock2(map, i1, i2);
+    if ((i = cuckoo_find_slot(b1, key)) != CUCKOO_SLOT_NONE) {
+      old = b1->data[i];
+      b1->data[i] = combiner(old, arg);
+    } else if ((i = cuckoo_find_slot(b2, key)) != CUCKOO_SLOT_NONE) {
+      old = b2->data[i];
+      b2->data[i] = combiner(old, arg);
+    } else if ((i = cuckoo_find_slot(b1, LMN_HASH_EMPTY_KEY)) != CUCKOO_SLOT_NONE) {
+      b1->data[i] = combiner(old, arg);
+      b1->keys[i] = key;
+    } else if ((i = cuckoo_find_slot(b2, LMN_HASH_EMPTY_KEY)) != CUCKOO_SLOT_NONE) {
+      b2->data[i] = combiner(old, arg);
+      b2->keys[i] = key;
+    }
+    cuckoo_unlock2(map, i1, i2);
+    if (i != CUCKOO_SLOT_NONE) return old;
+    if (!cuckoo_make_room(map, i1, i2)) break;
+  }
+  LMN_DBG("[debug] cuckoo_update: no free slot within %d moves, key:%lu\n", CUCKOO_MAX_DEPTH, key);
+  fprintf(stderr, "full!!!!\n");
+  exit(1);
+}
+
+/* keys whose first bucket is full are put afterwards, displacing others as usual */
+void cuckoo_bulk_load(cuckoo_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads) {
+  bulk_partition_t p;
+  cuckoo_bulk_t    b = { map, &p };
+  bulk_partition(&p, keys, values, n, map->bucket_mask, 0, nthreads);
+  RunParallel(nthreads, cuckoo_bulk_worker, &b);
+  bulk_put_deferred(&p, (hashmap_put_t)cuckoo_put, map);
+  bulk_partition_free(&p);
+}
+
+void cuckoo_free(cuckoo_hashmap_t *map) {
+  lmn_table_free(map->raw, cuckoo_bucket_t, cuckoo_slots(map) + 1);
+}
+
+lmn_word cuckoo_slots(cuckoo_hashmap_t *map) {
+  return map->bucket_mask + 1;
+}
+
+/* a key displaced by a concurrent insert may be reported twice or missed */
+void cuckoo_scan(cuckoo_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  for (lmn_word i = begin; i < end; i++) {
+    cuckoo_bucket_t *b = &map->buckets[i];
+    lmn_key_t  keys[CUCKOO_SLOTS];
+    lmn_data_t data[CUCKOO_SLOTS];
+    lmn_word v;
+    do {
+      v = cuckoo_read_version(b);
+      for (int j = 0; j < CUCKOO_SLOTS; j++) {
+        keys[j] = b->keys[j];
+        data[j] = b->data[j];
+      }
+      LMN_COMPILER_BARRIER();
+    } while (b->version != v);
+    for (int j = 0; j < CUCKOO_SLOTS; j++) {
+      if (keys[j] != LMN_HASH_EMPTY_KEY) fn(keys[j], data[j], arg);
+    }
+  }
+}
+
+/* keys are read without the bucket versions; a key moved meanwhile may be counted twice or not at all */
+void cuckoo_stats(cuckoo_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_stats_t *out) {
+  out->allocated += (end - begin) * sizeof(cuckoo_bucket_t);
+  out->committed += lmn_table_committed(&map->buckets[begin], (end - begin) * sizeof(cuckoo_bucket_t));
+  for (lmn_word i = begin; i < end; i++) {
+    cuckoo_bucket_t *b = &map->buckets[i];
+    lmn_word used = 0;
+    for (int j = 0; j < CUCKOO_SLOTS; j++) {
+      lmn_key_t key = b->keys[j];
+      if (key == LMN_HASH_EMPTY_KEY) continue;
+      hashmap_stats_record(out->distance, cuckoo_bucket1(map, key) == i ? 0 : 1);
+      used++;
+    }
+    hashmap_stats_record(out->fill, used);
+    out->entries += used;
+  }
+}
+
+}
+}
+}
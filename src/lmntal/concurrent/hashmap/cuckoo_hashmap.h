@@ -0,0 +1,52 @@
+/**
+ * @file   cuckoo_hashmap.h
+ * @brief
+ * Concurrent bucketized cuckoo hashing with optimistic per-bucket version counters.
+ * A key lives in one of two buckets and every bucket is one cache line, so a lookup
+ * touches at most two cache lines. Writers lock a bucket by making its version odd;
+ * readers retry when a version changed under them.
+ * MemC3 : https://www.cs.cmu.edu/~dga/papers/memc3-nsdi2013.pdf
+ * libcuckoo : https://github.com/efficient/libcuckoo
+ * @author Taketo Yoshida
+ */
+#ifndef CUCKOO_HASHMAP_H
+#  define CUCKOO_HASHMAP_H
+
+#include "hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define CUCKOO_SLOTS 3
+
+typedef struct {
+  lmn_word   volatile version; // odd while a writer holds the bucket
+  lmn_key_t  volatile keys[CUCKOO_SLOTS];
+  lmn_data_t volatile data[CUCKOO_SLOTS];
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) cuckoo_bucket_t;
+
+typedef struct {
+  cuckoo_bucket_t *buckets;
+  lmn_word         bucket_mask;
+  void            *raw;  // unaligned allocation of buckets
+} cuckoo_hashmap_t;
+
+void cuckoo_init(cuckoo_hashmap_t *map);
+void cuckoo_init_with_size(cuckoo_hashmap_t *map, lmn_word nbuckets);
+lmn_data_t cuckoo_find(cuckoo_hashmap_t *map, lmn_key_t key);
+void cuckoo_find_batch(cuckoo_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+void cuckoo_put(cuckoo_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+lmn_data_t cuckoo_update(cuckoo_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg);
+void cuckoo_bulk_load(cuckoo_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads);
+void cuckoo_free(cuckoo_hashmap_t *map);
+lmn_word cuckoo_slots(cuckoo_hashmap_t *map);
+void cuckoo_scan(cuckoo_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+void cuckoo_stats(cuckoo_hashmap_t *map, lmn_word begin, lmn_word end, struct _hashmap_stats_t *out);
+
+}
+}
+}
+
+#endif /* ifndef CUCKOO_HASHMAP_H */
+
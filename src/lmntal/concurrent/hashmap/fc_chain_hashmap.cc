@@ -0,0 +1,113 @@
+/**
+ * @file   fc_chain_hashmap.cc
+ * @brief  
+ * @author Taketo Yoshida
+ */
+#include "fc_chain_hashmap.h"
+#include "../thread.h"
+#include <sched.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define FC_CHAIN_SPIN 64
+
+/*
+ * private functions
+ */
+
+inline fc_chain_request_t *fc_chain_slot(fc_chain_hashmap_t *map, int segment, int tid) {
+  return &map->pub[segment * LMN_MAX_THREADS + tid];
+}
+
+/* serves every pending request of segment; the caller holds its lock */
+void fc_chain_combine(fc_chain_hashmap_t *map, int segment) {
+  chain_hashmap_t *base = &map->base;
+  int nslots = map->nslots;
+  for (int i = 0; i < nslots; i++) {
+    fc_chain_request_t *req = fc_chain_slot(map, segment, i);
+    int op = req->op;
+    if (op != FC_CHAIN_OP_FIND && op != FC_CHAIN_OP_PUT) continue;
+    LMN_COMPILER_BARRIER();
+    lmn_word bucket = hash<lmn_word>(req->key) & base->bucket_mask;
+    if ((int)(bucket % HASHMAP_SEGMENT) != segment) {
+      req->op = FC_CHAIN_OP_RETRY;
+      continue;
+    }
+    if (op == FC_CHAIN_OP_FIND) {
+      req->data = chain_find_locked(base, bucket, req->key);
+    } else {
+      chain_put_locked(base, bucket, req->key, req->data);
+    }
+    LMN_COMPILER_BARRIER();
+    req->op = FC_CHAIN_OP_NONE;
+  }
+}
+
+lmn_data_t fc_chain_request(fc_chain_hashmap_t *map, int op, lmn_key_t key, lmn_data_t data) {
+  chain_hashmap_t *base = &map->base;
+  int tid = GetCurrentThreadId();
+  int nslots;
+
+  while ((nslots = map->nslots) <= tid && !LMN_CAS(&map->nslots, nslots, tid + 1));
+  for (;;) {
+    int segment = (hash<lmn_word>(key) & base->bucket_mask) % HASHMAP_SEGMENT;
+    fc_chain_request_t *req = fc_chain_slot(map, segment, tid);
+    req->key  = key;
+    req->data = data;
+    LMN_COMPILER_BARRIER();
+    req->op   = op;
+
+    while (req->op == op) {
+      if (lmn_lock_try(chain_segment_lock<lmn_mutex_lock_t>(base, segment))) {
+        fc_chain_combine(map, segment);
+        lmn_lock_release(chain_segment_lock<lmn_mutex_lock_t>(base, segment));
+        break;
+      }
+      for (int i = 0; i < FC_CHAIN_SPIN && req->op == op; i++) {
+        LMN_CPU_RELAX();
+      }
+      // the combiner may have been preempted, let it run
+      if (req->op == op) sched_yield();
+    }
+    if (req->op == FC_CHAIN_OP_NONE) {
+      LMN_COMPILER_BARRIER();
+      return req->data;
+    }
+    req->op = FC_CHAIN_OP_NONE;
+  }
+}
+
+/*
+ * public functions
+ */
+
+void fc_chain_init(fc_chain_hashmap_t *map) {
+  chain_init(&map->base);
+  map->nslots = 0;
+  // slots must not share cache lines, which calloc does not guarantee
+  if (posix_memalign((void**)&map->pub, LMN_CACHE_LINE_SIZE, sizeof(fc_chain_request_t) * HASHMAP_SEGMENT * LMN_MAX_THREADS) != 0) {
+    fprintf(stderr, "failed to allocate publication slots\n");
+    exit(1);
+  }
+  memset(map->pub, 0x00, sizeof(fc_chain_request_t) * HASHMAP_SEGMENT * LMN_MAX_THREADS);
+}
+
+lmn_data_t fc_chain_find(fc_chain_hashmap_t *map, lmn_key_t key) {
+  return fc_chain_request(map, FC_CHAIN_OP_FIND, key, NULL);
+}
+
+void fc_chain_put(fc_chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  fc_chain_request(map, FC_CHAIN_OP_PUT, key, data);
+  chain_resize_if_needed(&map->base);
+}
+
+void fc_chain_free(fc_chain_hashmap_t *map) {
+  chain_free(&map->base);
+  lmn_free(map->pub);
+}
+
+}
+}
+}
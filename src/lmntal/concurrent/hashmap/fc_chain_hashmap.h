@@ -0,0 +1,48 @@
+/**
+ * @file   fc_chain_hashmap.h
+ * @brief
+ * Flat-combining front end for the lock-striped chain hashmap.
+ * A thread publishes its find/put in its slot of the segment's publication array and
+ * tries the segment lock; whoever gets the lock serves every pending request of that
+ * segment while its buckets are hot in its cache, the others just wait for their slot
+ * to be cleared.
+ * Flat Combining : http://mcg.cs.tau.ac.il/papers/spaa2010-fc.pdf
+ * @author Taketo Yoshida
+ */
+#ifndef FC_CHAIN_HASHMAP_H
+#  define FC_CHAIN_HASHMAP_H
+
+#include "chain_hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define FC_CHAIN_OP_NONE  0  // slot is free, or the request has been served
+#define FC_CHAIN_OP_FIND  1
+#define FC_CHAIN_OP_PUT   2
+#define FC_CHAIN_OP_RETRY 3  // a rehash moved the key to another segment
+
+typedef struct {
+  int        volatile op;
+  lmn_key_t  volatile key;
+  lmn_data_t volatile data; // argument of put, result of find
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) fc_chain_request_t;
+
+typedef struct {
+  chain_hashmap_t     base; // first, so the chain scan works on this map as is
+  fc_chain_request_t *pub;  // HASHMAP_SEGMENT x LMN_MAX_THREADS, indexed by thread id
+  int        volatile nslots; // highest thread id that ever published, plus one
+} fc_chain_hashmap_t;
+
+void fc_chain_init(fc_chain_hashmap_t *map);
+lmn_data_t fc_chain_find(fc_chain_hashmap_t *map, lmn_key_t key);
+void fc_chain_put(fc_chain_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+void fc_chain_free(fc_chain_hashmap_t *map);
+
+}
+}
+}
+
+#endif /* ifndef FC_CHAIN_HASHMAP_H */
+
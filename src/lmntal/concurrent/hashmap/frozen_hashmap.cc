@@ -0,0 +1,185 @@
+/**
+ * @file   frozen_hashmap.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "frozen_hashmap.h"
+#include "table_alloc.h"
+#include "../thread.h"
+#include <algorithm>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define FROZEN_HASH_BITS 32
+
+typedef struct {
+  frozen_hashmap_t *map;
+  lmn_key_t        *keys;
+  lmn_data_t       *values;
+  int               part_bits;
+  lmn_word         *offsets;  // nthreads x partitions, counts and then scatter positions
+  lmn_word         *parts;    // first entry of every partition, plus the end
+  int      volatile cursor;
+} frozen_build_t;
+
+/*
+ * private functions
+ */
+
+inline lmn_word frozen_hash(lmn_key_t key) {
+  return hash<lmn_word>(key);
+}
+
+inline bool frozen_entry_less(const frozen_entry_t &a, const frozen_entry_t &b) {
+  lmn_word ha = frozen_hash(a.key), hb = frozen_hash(b.key);
+  return (ha != hb) ? ha < hb : a.key < b.key;
+}
+
+inline int frozen_partition(frozen_build_t *b, lmn_key_t key) {
+  return (int)(frozen_hash(key) >> (FROZEN_HASH_BITS - b->part_bits));
+}
+
+inline void frozen_slice(frozen_build_t *b, int index, int nthreads, lmn_word *begin, lmn_word *end) {
+  *begin = b->map->count * index / nthreads;
+  *end   = b->map->count * (index + 1) / nthreads;
+}
+
+void frozen_histogram_worker(int index, int nthreads, void *arg) {
+  frozen_build_t *b = (frozen_build_t*)arg;
+  lmn_word *counts = &b->offsets[(lmn_word)index << b->part_bits];
+  lmn_word begin, end;
+  frozen_slice(b, index, nthreads, &begin, &end);
+  for (lmn_word i = begin; i < end; i++) {
+    counts[frozen_partition(b, b->keys[i])]++;
+  }
+}
+
+void frozen_scatter_worker(int index, int nthreads, void *arg) {
+  frozen_build_t *b = (frozen_build_t*)arg;
+  lmn_word *pos = &b->offsets[(lmn_word)index << b->part_bits];
+  lmn_word begin, end;
+  frozen_slice(b, index, nthreads, &begin, &end);
+  for (lmn_word i = begin; i < end; i++) {
+    frozen_entry_t *e = &b->map->entries[pos[frozen_partition(b, b->keys[i])]++];
+    e->key  = b->keys[i];
+    e->data = b->values[i];
+  }
+}
+
+/* partitions are sorted independently, each one owns a contiguous range of the directory */
+void frozen_sort_worker(int index, int nthreads, void *arg) {
+  frozen_build_t   *b     = (frozen_build_t*)arg;
+  frozen_hashmap_t *map   = b->map;
+  int               shift = FROZEN_HASH_BITS - map->dir_bits;
+  lmn_word          per   = (lmn_word)1 << (map->dir_bits - b->part_bits);
+  int p;
+  while ((p = LMN_ATOMIC_ADD(&b->cursor, 1)) < (1 << b->part_bits)) {
+    lmn_word i = b->parts[p], end = b->parts[p + 1];
+    std::sort(map->entries + i, map->entries + end, frozen_entry_less);
+    for (lmn_word d = p * per; d < (p + 1) * per; d++) {
+      while (i < end && (frozen_hash(map->entries[i].key) >> shift) < d) i++;
+      map->dir[d] = (uint32_t)i;
+    }
+  }
+}
+
+/*
+ * public functions
+ */
+
+void frozen_init(frozen_hashmap_t *map) {
+  map->dir_bits = 1;
+  map->count    = 0;
+  map->entries  = NULL;
+  map->dir      = lmn_table_calloc(uint32_t, (1 << map->dir_bits) + 1);
+}
+
+/*
+ * Export, then a parallel radix partition on the top hash bits: per-thread
+ * histograms, a prefix sum into scatter positions, the scatter itself, and
+ * a sort of every partition which also fills its part of the directory.
+ * The source must not be modified while the snapshot is built.
+ */
+void frozen_build(frozen_hashmap_t *map, hashmap_t *src, int nthreads) {
+  if (nthreads < 1) nthreads = 1;
+  lmn_word capacity = hashmap_count(src, nthreads);
+  if (capacity >= UINT32_MAX) {
+    fprintf(stderr, "too many entries to freeze: %lu\n", capacity);
+    exit(1);
+  }
+  frozen_build_t b;
+  memset(&b, 0x00, sizeof(frozen_build_t));
+  b.map    = map;
+  b.keys   = lmn_calloc(lmn_key_t, capacity + 1);
+  b.values = lmn_calloc(lmn_data_t, capacity + 1);
+  map->count = hashmap_export(src, b.keys, b.values, capacity, nthreads);
+
+  // 2-4 entries per directory bucket
+  map->dir_bits = 1;
+  while (((lmn_word)1 << (map->dir_bits + 2)) <= map->count && map->dir_bits < FROZEN_HASH_BITS) map->dir_bits++;
+  b.part_bits  = std::min(map->dir_bits, FROZEN_PARTITION_BITS);
+  map->entries = lmn_table_calloc(frozen_entry_t, map->count + 1);
+  map->dir     = lmn_table_calloc(uint32_t, ((lmn_word)1 << map->dir_bits) + 1);
+
+  lmn_word nparts = (lmn_word)1 << b.part_bits;
+  b.offsets = lmn_calloc(lmn_word, nparts * nthreads);
+  b.parts   = lmn_calloc(lmn_word, nparts + 1);
+  RunParallel(nthreads, frozen_histogram_worker, &b);
+  lmn_word pos = 0;
+  for (lmn_word p = 0; p < nparts; p++) {
+    b.parts[p] = pos;
+    for (int t = 0; t < nthreads; t++) {
+      lmn_word n = b.offsets[t * nparts + p];
+      b.offsets[t * nparts + p] = pos;
+      pos += n;
+    }
+  }
+  b.parts[nparts] = pos;
+  RunParallel(nthreads, frozen_scatter_worker, &b);
+  lmn_free(b.keys);
+  lmn_free(b.values);
+  RunParallel(nthreads, frozen_sort_worker, &b);
+  map->dir[(lmn_word)1 << map->dir_bits] = (uint32_t)map->count;
+  lmn_free(b.offsets);
+  lmn_free(b.parts);
+}
+
+lmn_data_t frozen_find(frozen_hashmap_t *map, lmn_key_t key) {
+  lmn_word  d   = frozen_hash(key) >> (FROZEN_HASH_BITS - map->dir_bits);
+  uint32_t  end = map->dir[d + 1];
+  for (uint32_t i = map->dir[d]; i < end; i++) {
+    if (map->entries[i].key == key) return map->entries[i].data;
+  }
+  return LMN_HASH_EMPTY_DATA;
+}
+
+void frozen_put(frozen_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  fprintf(stderr, "put into a frozen hashmap\n");
+  exit(1);
+}
+
+void frozen_free(frozen_hashmap_t *map) {
+  lmn_table_free(map->entries, frozen_entry_t, map->count + 1);
+  lmn_table_free(map->dir, uint32_t, ((lmn_word)1 << map->dir_bits) + 1);
+}
+
+lmn_word frozen_slots(frozen_hashmap_t *map) {
+  return map->count;
+}
+
+void frozen_scan(frozen_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  for (lmn_word i = begin; i < end; i++) {
+    fn(map->entries[i].key, map->entries[i].data, arg);
+  }
+}
+
+/* bytes of the entry array and the directory */
+lmn_word frozen_bytes(frozen_hashmap_t *map) {
+  return map->count * sizeof(frozen_entry_t) + (((lmn_word)1 << map->dir_bits) + 1) * sizeof(uint32_t);
+}
+
+}
+}
+}
@@ -0,0 +1,48 @@
+/**
+ * @file   frozen_hashmap.h
+ * @brief
+ * Immutable snapshot of another hashmap for read-only phases (counterexample and witness analysis).
+ * Entries are packed without empty slots and sorted by hash; a directory indexed by the top hash
+ * bits points at the 2-4 entries that can hold a key, so a find reads the directory word and then
+ * (usually) one cache line of entries. Built in parallel, and finds take no locks.
+ * @author Taketo Yoshida
+ */
+#ifndef FROZEN_HASHMAP_H
+#  define FROZEN_HASHMAP_H
+
+#include "hashmap.h"
+#include <stdint.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define FROZEN_PARTITION_BITS 10 // radix partitions used while building
+
+typedef struct {
+  lmn_key_t  key;
+  lmn_data_t data;
+} frozen_entry_t;
+
+typedef struct {
+  frozen_entry_t *entries;
+  uint32_t       *dir;      // 2^dir_bits + 1 offsets into entries
+  int             dir_bits;
+  lmn_word        count;
+} frozen_hashmap_t;
+
+void frozen_init(frozen_hashmap_t *map);
+void frozen_build(frozen_hashmap_t *map, hashmap_t *src, int nthreads);
+lmn_data_t frozen_find(frozen_hashmap_t *map, lmn_key_t key);
+void frozen_put(frozen_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+void frozen_free(frozen_hashmap_t *map);
+lmn_word frozen_slots(frozen_hashmap_t *map);
+void frozen_scan(frozen_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+lmn_word frozen_bytes(frozen_hashmap_t *map);
+
+}
+}
+}
+
+#endif /* ifndef FROZEN_HASHMAP_H */
+
@@ -7,6 +7,13 @@
 #include "chain_hashmap.h"
 #include "lf_chain_hashmap.h"
 #include "cc_hashmap.h"
+#include "bitstate_hashmap.h"
+#include "cuckoo_hashmap.h"
+#include "cc_compact_hashmap.h"
+#include "fc_chain_hashmap.h"
+#include "tiered_hashmap.h"
+#include "frozen_hashmap.h"
+#include "../thread.h"
 
 namespace lmntal {
 namespace concurrent {
@@ -17,6 +24,12 @@ static const hashmap_impl_t CHAIN_HASHMAP_IMPL_HT = {
   (hashmap_put_t)chain_put,
   (hashmap_init_t)chain_init,
   (hashmap_free_t)chain_free,
+  (hashmap_slots_t)chain_slots,
+  (hashmap_scan_t)chain_scan,
+  (hashmap_find_batch_t)chain_find_batch,
+  (hashmap_bulk_load_t)chain_bulk_load,
+  (hashmap_update_t)chain_update,
+  (hashmap_stats_range_t)chain_stats,
 };
 
 static const hashmap_impl_t LF_CHAIN_HASHMAP_IMPL_HT = { 
@@ -24,6 +37,12 @@ static const hashmap_impl_t LF_CHAIN_HASHMAP_IMPL_HT = {
   (hashmap_put_t)lf_chain_put,
   (hashmap_init_t)lf_chain_init,
   (hashmap_free_t)lf_chain_free,
+  (hashmap_slots_t)lf_chain_slots,
+  (hashmap_scan_t)lf_chain_scan,
+  (hashmap_find_batch_t)lf_chain_find_batch,
+  (hashmap_bulk_load_t)lf_chain_bulk_load,
+  (hashmap_update_t)lf_chain_update,
+  (hashmap_stats_range_t)lf_chain_stats,
 };
 
 static const hashmap_impl_t CC_HASHMAP_IMPL_HT = { 
@@ -31,6 +50,112 @@ static const hashmap_impl_t CC_HASHMAP_IMPL_HT = {
   (hashmap_put_t)lmn_hashmap_put,
   (hashmap_init_t)lmn_hashmap_init,
   (hashmap_free_t)lmn_hashmap_free,
+  (hashmap_slots_t)lmn_hashmap_slots,
+  (hashmap_scan_t)lmn_hashmap_scan,
+  (hashmap_find_batch_t)lmn_hashmap_find_batch,
+  (hashmap_bulk_load_t)lmn_hashmap_bulk_load,
+  (hashmap_update_t)lmn_hashmap_update,
+  (hashmap_stats_range_t)lmn_hashmap_stats,
+};
+
+static const hashmap_impl_t BITSTATE_HASHMAP_IMPL_HT = { 
+  (hashmap_find_t)bitstate_find,
+  (hashmap_put_t)bitstate_put,
+  (hashmap_init_t)bitstate_init,
+  (hashmap_free_t)bitstate_free,
+};
+
+static const hashmap_impl_t CUCKOO_HASHMAP_IMPL_HT = { 
+  (hashmap_find_t)cuckoo_find,
+  (hashmap_put_t)cuckoo_put,
+  (hashmap_init_t)cuckoo_init,
+  (hashmap_free_t)cuckoo_free,
+  (hashmap_slots_t)cuckoo_slots,
+  (hashmap_scan_t)cuckoo_scan,
+  (hashmap_find_batch_t)cuckoo_find_batch,
+  (hashmap_bulk_load_t)cuckoo_bulk_load,
+  (hashmap_update_t)cuckoo_update,
+  (hashmap_stats_range_t)cuckoo_stats,
+};
+
+static const hashmap_impl_t CC_COMPACT_HASHMAP_IMPL_HT = { 
+  (hashmap_find_t)cc_compact_find,
+  (hashmap_put_t)cc_compact_put,
+  (hashmap_init_t)cc_compact_init,
+  (hashmap_free_t)cc_compact_free,
+  (hashmap_slots_t)cc_compact_slots,
+  (hashmap_scan_t)cc_compact_scan,
+  (hashmap_find_batch_t)cc_compact_find_batch,
+  (hashmap_bulk_load_t)cc_compact_bulk_load,
+  (hashmap_update_t)cc_compact_update,
+  (hashmap_stats_range_t)cc_compact_stats,
+};
+
+static const hashmap_impl_t FC_CHAIN_HASHMAP_IMPL_HT = { 
+  (hashmap_find_t)fc_chain_find,
+  (hashmap_put_t)fc_chain_put,
+  (hashmap_init_t)fc_chain_init,
+  (hashmap_free_t)fc_chain_free,
+  (hashmap_slots_t)chain_slots,
+  (hashmap_scan_t)chain_scan,
+  NULL,
+  (hashmap_bulk_load_t)chain_bulk_load,
+  (hashmap_update_t)chain_update,
+  (hashmap_stats_range_t)chain_stats,
+};
+
+static const hashmap_impl_t TIERED_HASHMAP_IMPL_HT = { 
+  (hashmap_find_t)tiered_find,
+  (hashmap_put_t)tiered_put,
+  (hashmap_init_t)tiered_init,
+  (hashmap_free_t)tiered_free,
+  (hashmap_slots_t)tiered_slots,
+  (hashmap_scan_t)tiered_scan,
+  (hashmap_find_batch_t)tiered_find_batch,
+};
+
+static const hashmap_impl_t FROZEN_HASHMAP_IMPL_HT = { 
+  (hashmap_find_t)frozen_find,
+  (hashmap_put_t)frozen_put,
+  (hashmap_init_t)frozen_init,
+  (hashmap_free_t)frozen_free,
+  (hashmap_slots_t)frozen_slots,
+  (hashmap_scan_t)frozen_scan,
+};
+
+static const hashset_impl_t CHAIN_HASHSET_IMPL_HT = { 
+  (hashset_contains_t)chain_set_contains,
+  (hashset_insert_t)chain_set_insert,
+  (hashmap_init_t)chain_init,
+  (hashmap_free_t)chain_free,
+};
+
+static const hashset_impl_t LF_CHAIN_HASHSET_IMPL_HT = { 
+  (hashset_contains_t)lf_chain_set_contains,
+  (hashset_insert_t)lf_chain_set_insert,
+  (hashmap_init_t)lf_chain_init,
+  (hashmap_free_t)lf_chain_free,
+};
+
+static const hashset_impl_t CC_HASHSET_IMPL_HT = { 
+  (hashset_contains_t)lmn_hashset_contains,
+  (hashset_insert_t)lmn_hashset_insert,
+  (hashmap_init_t)lmn_hashset_init,
+  (hashmap_free_t)lmn_hashmap_free,
+};
+
+static const hashset_impl_t BITSTATE_HASHSET_IMPL_HT = { 
+  (hashset_contains_t)bitstate_set_contains,
+  (hashset_insert_t)bitstate_set_insert,
+  (hashmap_init_t)bitstate_init,
+  (hashmap_free_t)bitstate_free,
+};
+
+static const hashset_impl_t CC_COMPACT_HASHSET_IMPL_HT = { 
+  (hashset_contains_t)cc_compact_set_contains,
+  (hashset_insert_t)cc_compact_set_insert,
+  (hashmap_init_t)cc_compact_set_init,
+  (hashmap_free_t)cc_compact_free,
 };
 
 void hashmap_init(hashmap_t *map, hashmap_type_t type) {
@@ -47,10 +172,322 @@ void hashmap_init(hashmap_t *map, hashmap_type_t type) {
       map->data = lmn_malloc(lmn_hashmap_t);
       map->impl = CC_HASHMAP_IMPL_HT;
       break;
+    case LMN_BITSTATE:
+      map->data = lmn_malloc(bitstate_hashmap_t);
+      map->impl = BITSTATE_HASHMAP_IMPL_HT;
+      break;
+    case LMN_CUCKOO:
+      map->data = lmn_malloc(cuckoo_hashmap_t);
+      map->impl = CUCKOO_HASHMAP_IMPL_HT;
+      break;
+    case LMN_MC_CLIFF_CLICK_COMPACT:
+      map->data = lmn_malloc(cc_compact_hashmap_t);
+      map->impl = CC_COMPACT_HASHMAP_IMPL_HT;
+      break;
+    case LMN_CLOSED_ADDRESSING_COMBINING:
+      map->data = lmn_malloc(fc_chain_hashmap_t);
+      map->impl = FC_CHAIN_HASHMAP_IMPL_HT;
+      break;
+    case LMN_MC_CLIFF_CLICK_TIERED:
+      map->data = lmn_malloc(tiered_hashmap_t);
+      map->impl = TIERED_HASHMAP_IMPL_HT;
+      break;
   }
+  map->trace = NULL;
+  map->front = NULL;
   map->impl.init(map->data);
 }
 
+void hashmap_bitstate_init(hashmap_t *map, lmn_word nbits, int nhashes) {
+  map->data = lmn_malloc(bitstate_hashmap_t);
+  map->impl = BITSTATE_HASHMAP_IMPL_HT;
+  map->trace = NULL;
+  map->front = NULL;
+  bitstate_init_with_size((bitstate_hashmap_t*)map->data, nbits, nhashes);
+}
+
+void hashmap_cc_init_with_size(hashmap_t *map, lmn_word slots) {
+  map->data = lmn_malloc(lmn_hashmap_t);
+  map->impl = CC_HASHMAP_IMPL_HT;
+  map->trace = NULL;
+  map->front = NULL;
+  lmn_hashmap_init_with_size((lmn_hashmap_t*)map->data, slots);
+}
+
+/* a closed-addressing map whose segment locks follow policy (lmn_lock_policy_t) */
+void hashmap_chain_init_with_lock(hashmap_t *map, int policy) {
+  map->data = lmn_malloc(chain_hashmap_t);
+  map->impl = *chain_impl_with_lock(policy);
+  map->trace = NULL;
+  map->front = NULL;
+  chain_init_with_lock((chain_hashmap_t*)map->data, policy);
+}
+
+void hashmap_tiered_init(hashmap_t *map, lmn_word mem_slots, const char *dir) {
+  map->data = lmn_malloc(tiered_hashmap_t);
+  map->impl = TIERED_HASHMAP_IMPL_HT;
+  map->trace = NULL;
+  map->front = NULL;
+  tiered_init_with_size((tiered_hashmap_t*)map->data, mem_slots, dir);
+}
+
+void hashset_init(hashset_t *set, hashmap_type_t type) {
+  switch (type) {
+    case LMN_CLOSED_ADDRESSING:
+      set->data = lmn_malloc(chain_hashmap_t);
+      set->impl = CHAIN_HASHSET_IMPL_HT;
+      break;
+    case LMN_LOCK_FREE_CLOSED_ADDRESSING:
+      set->data = lmn_malloc(lf_chain_hashmap_t);
+      set->impl = LF_CHAIN_HASHSET_IMPL_HT;
+      break;
+    case LMN_MC_CLIFF_CLICK:
+      set->data = lmn_malloc(lmn_hashmap_t);
+      set->impl = CC_HASHSET_IMPL_HT;
+      break;
+    case LMN_BITSTATE:
+      set->data = lmn_malloc(bitstate_hashmap_t);
+      set->impl = BITSTATE_HASHSET_IMPL_HT;
+      break;
+    case LMN_MC_CLIFF_CLICK_COMPACT:
+      set->data = lmn_malloc(cc_compact_hashmap_t);
+      set->impl = CC_COMPACT_HASHSET_IMPL_HT;
+      break;
+    default:
+      fprintf(stderr, "no set specialization for this hashmap type\n");
+      exit(1);
+  }
+  set->impl.init(set->data);
+}
+
+void hashset_bitstate_init(hashset_t *set, lmn_word nbits, int nhashes) {
+  set->data = lmn_malloc(bitstate_hashmap_t);
+  set->impl = BITSTATE_HASHSET_IMPL_HT;
+  bitstate_init_with_size((bitstate_hashmap_t*)set->data, nbits, nhashes);
+}
+
+/*
+ * iteration
+ */
+
+typedef struct {
+  hashmap_t               *map;
+  lmn_word                 slots;
+  lmn_word        volatile cursor;
+  lmn_word        volatile result;
+  hashmap_iter_t           fn;
+  void                    *arg;
+  lmn_key_t               *keys;
+  lmn_data_t              *values;
+  lmn_word                 capacity;
+} hashmap_scan_state_t;
+
+typedef struct {
+  lmn_key_t  *keys;
+  lmn_data_t *values;
+  lmn_word    n;
+  lmn_word    cap;
+} hashmap_export_buf_t;
+
+static void hashmap_scan_state_init(hashmap_scan_state_t *st, hashmap_t *map) {
+  if (map->impl.scan == NULL) {
+    fprintf(stderr, "scan is not supported by this hashmap\n");
+    exit(1);
+  }
+  memset(st, 0x00, sizeof(hashmap_scan_state_t));
+  st->map   = map;
+  st->slots = map->impl.slots(map->data);
+}
+
+static int hashmap_scan_next_chunk(hashmap_scan_state_t *st, lmn_word *begin, lmn_word *end) {
+  lmn_word b = LMN_ATOMIC_ADD(&st->cursor, HASHMAP_SCAN_CHUNK);
+  if (b >= st->slots) return FALSE;
+  *begin = b;
+  *end   = (st->slots - b < HASHMAP_SCAN_CHUNK) ? st->slots : b + HASHMAP_SCAN_CHUNK;
+  return TRUE;
+}
+
+static void hashmap_scan_worker(int index, int nthreads, void *arg) {
+  hashmap_scan_state_t *st = (hashmap_scan_state_t*)arg;
+  lmn_word begin, end;
+  while (hashmap_scan_next_chunk(st, &begin, &end)) {
+    st->map->impl.scan(st->map->data, begin, end, st->fn, st->arg);
+  }
+}
+
+static void hashmap_count_iter(lmn_key_t key, lmn_data_t data, void *arg) {
+  (*(lmn_word*)arg)++;
+}
+
+static void hashmap_count_worker(int index, int nthreads, void *arg) {
+  hashmap_scan_state_t *st = (hashmap_scan_state_t*)arg;
+  lmn_word begin, end, n = 0;
+  while (hashmap_scan_next_chunk(st, &begin, &end)) {
+    st->map->impl.scan(st->map->data, begin, end, hashmap_count_iter, &n);
+  }
+  LMN_ATOMIC_ADD(&st->result, n);
+}
+
+static void hashmap_export_iter(lmn_key_t key, lmn_data_t data, void *arg) {
+  hashmap_export_buf_t *buf = (hashmap_export_buf_t*)arg;
+  if (LMN_UNLIKELY(buf->n == buf->cap)) {
+    buf->cap    = (buf->cap == 0) ? 1024 : buf->cap << 1;
+    buf->keys   = (lmn_key_t*)realloc(buf->keys, sizeof(lmn_key_t) * buf->cap);
+    buf->values = (lmn_data_t*)realloc(buf->values, sizeof(lmn_data_t) * buf->cap);
+  }
+  buf->keys[buf->n]   = key;
+  buf->values[buf->n] = data;
+  buf->n++;
+}
+
+/* each chunk is collected locally first, so the output cursor is bumped once per chunk */
+static void hashmap_export_worker(int index, int nthreads, void *arg) {
+  hashmap_scan_state_t *st = (hashmap_scan_state_t*)arg;
+  hashmap_export_buf_t buf = { NULL, NULL, 0, 0 };
+  lmn_word begin, end;
+  while (hashmap_scan_next_chunk(st, &begin, &end)) {
+    buf.n = 0;
+    st->map->impl.scan(st->map->data, begin, end, hashmap_export_iter, &buf);
+    if (buf.n == 0) continue;
+    lmn_word pos = LMN_ATOMIC_ADD(&st->result, buf.n);
+    if (pos >= st->capacity) continue;
+    lmn_word n = (st->capacity - pos < buf.n) ? st->capacity - pos : buf.n;
+    memcpy(&st->keys[pos], buf.keys, sizeof(lmn_key_t) * n);
+    if (st->values != NULL)
+      memcpy(&st->values[pos], buf.values, sizeof(lmn_data_t) * n);
+  }
+  free(buf.keys);
+  free(buf.values);
+}
+
+void hashmap_for_each(hashmap_t *map, hashmap_iter_t fn, void *arg) {
+  hashmap_scan_state_t st;
+  hashmap_scan_state_init(&st, map);
+  map->impl.scan(map->data, 0, st.slots, fn, arg);
+}
+
+void hashmap_parallel_scan(hashmap_t *map, int nthreads, hashmap_iter_t fn, void *arg) {
+  hashmap_scan_state_t st;
+  hashmap_scan_state_init(&st, map);
+  st.fn  = fn;
+  st.arg = arg;
+  RunParallel(nthreads, hashmap_scan_worker, &st);
+}
+
+lmn_word hashmap_count(hashmap_t *map, int nthreads) {
+  hashmap_scan_state_t st;
+  hashmap_scan_state_init(&st, map);
+  RunParallel(nthreads, hashmap_count_worker, &st);
+  return st.result;
+}
+
+/* values may be NULL when only the keys are wanted; returns the number of entries written */
+lmn_word hashmap_export(hashmap_t *map, lmn_key_t *keys, lmn_data_t *values, lmn_word capacity, int nthreads) {
+  hashmap_scan_state_t st;
+  hashmap_scan_state_init(&st, map);
+  st.keys     = keys;
+  st.values   = values;
+  st.capacity = capacity;
+  RunParallel(nthreads, hashmap_export_worker, &st);
+  return (st.result < capacity) ? st.result : capacity;
+}
+
+void hashmap_find_batch(hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  if (map->impl.find_batch != NULL) {
+    map->impl.find_batch(map->data, keys, out, n);
+  } else {
+    for (int i = 0; i < n; i++) {
+      out[i] = map->impl.find(map->data, keys[i]);
+    }
+  }
+  if (LMN_UNLIKELY(map->trace != NULL)) {
+    for (int i = 0; i < n; i++) {
+      hashmap_trace_record(map->trace, HASHMAP_TRACE_FIND, keys[i], out[i]);
+    }
+  }
+}
+
+typedef struct {
+  hashmap_t        *map;
+  const lmn_key_t  *keys;
+  const lmn_data_t *values;
+  lmn_word          n;
+} hashmap_bulk_t;
+
+static void hashmap_bulk_put_worker(int index, int nthreads, void *arg) {
+  hashmap_bulk_t *b = (hashmap_bulk_t*)arg;
+  lmn_word begin = b->n * index / nthreads;
+  lmn_word end   = b->n * (index + 1) / nthreads;
+  for (lmn_word i = begin; i < end; i++) {
+    hashmap_put(b->map, b->keys[i], b->values[i]);
+  }
+}
+
+void hashmap_bulk_load(hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads) {
+  if (nthreads < 1) nthreads = 1;
+  if (map->impl.bulk_load != NULL && map->trace == NULL) {
+    map->impl.bulk_load(map->data, keys, values, n, nthreads);
+  } else {
+    hashmap_bulk_t b = { map, keys, values, n };
+    RunParallel(nthreads, hashmap_bulk_put_worker, &b);
+  }
+}
+
+lmn_data_t hashmap_update(hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  if (map->impl.update == NULL) {
+    fprintf(stderr, "update is not supported by this hashmap\n");
+    exit(1);
+  }
+  if (LMN_UNLIKELY(map->front != NULL)) hashmap_front_forget(map, key);
+  return map->impl.update(map->data, key, combiner, arg);
+}
+
+/* a find first, so that hits only read the shared lines */
+lmn_data_t hashmap_find_or_put_inner(hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  lmn_data_t old = map->impl.find(map->data, key);
+  if (old != LMN_HASH_EMPTY_DATA) return old;
+  if (map->impl.update != NULL) return map->impl.update(map->data, key, hashmap_combine_keep, data);
+  map->impl.put(map->data, key, data);
+  return LMN_HASH_EMPTY_DATA;
+}
+
+lmn_data_t hashmap_find_or_put(hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  lmn_data_t old = LMN_UNLIKELY(map->front != NULL) ? hashmap_front_find_or_put(map, key, data) : hashmap_find_or_put_inner(map, key, data);
+  if (LMN_UNLIKELY(map->trace != NULL)) {
+    hashmap_trace_record(map->trace, HASHMAP_TRACE_FIND, key, old);
+    if (old == LMN_HASH_EMPTY_DATA) hashmap_trace_record(map->trace, HASHMAP_TRACE_PUT, key, data);
+  }
+  return old;
+}
+
+lmn_data_t hashmap_combine_set(lmn_data_t value, lmn_data_t arg) {
+  return arg;
+}
+
+lmn_data_t hashmap_combine_keep(lmn_data_t value, lmn_data_t arg) {
+  return (value == LMN_HASH_EMPTY_DATA) ? arg : value;
+}
+
+lmn_data_t hashmap_combine_add(lmn_data_t value, lmn_data_t arg) {
+  return (lmn_data_t)((lmn_word)value + (lmn_word)arg);
+}
+
+lmn_data_t hashmap_combine_min(lmn_data_t value, lmn_data_t arg) {
+  return (value == LMN_HASH_EMPTY_DATA || (lmn_word)arg < (lmn_word)value) ? arg : value;
+}
+
+lmn_data_t hashmap_combine_max(lmn_data_t value, lmn_data_t arg) {
+  return ((lmn_word)arg > (lmn_word)value) ? arg : value;
+}
+
+void hashmap_freeze(hashmap_t *src, hashmap_t *dst, int nthreads) {
+  dst->data = lmn_malloc(frozen_hashmap_t);
+  dst->impl = FROZEN_HASHMAP_IMPL_HT;
+  dst->trace = NULL;
+  dst->front = NULL;
+  frozen_build((frozen_hashmap_t*)dst->data, src, nthreads);
+}
+
 }
 }
 }
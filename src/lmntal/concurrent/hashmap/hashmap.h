@@ -25,6 +25,11 @@ using namespace std;
 
 #define LMN_PREFETCH(addr, rw, locality) __builtin_prefetch(addr, rw, locality)
 
+#define LMN_CACHE_LINE_SIZE 64
+
+#define LMN_COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+#define LMN_CPU_RELAX()        __asm__ __volatile__("pause" ::: "memory")
+
 #define LMN_PTR_VAL(ptr) (*ptr)
 
 #define LMN_DEBUG
@@ -121,40 +126,187 @@ inline lmn_word hash(T val) {
 typedef enum {
   LMN_CLOSED_ADDRESSING = 0,
   LMN_LOCK_FREE_CLOSED_ADDRESSING,
-  LMN_MC_CLIFF_CLICK
+  LMN_MC_CLIFF_CLICK,
+  LMN_BITSTATE,
+  LMN_CUCKOO,
+  LMN_MC_CLIFF_CLICK_COMPACT,
+  LMN_CLOSED_ADDRESSING_COMBINING,
+  LMN_MC_CLIFF_CLICK_TIERED
 } hashmap_type_t;
 
 typedef lmn_data_t  (*hashmap_find_t)(lmn_map_t, lmn_word);
 typedef void        (*hashmap_put_t)(lmn_map_t, lmn_word, lmn_data_t);
 typedef void        (*hashmap_init_t)(lmn_map_t);
 typedef void        (*hashmap_free_t)(lmn_map_t);
+typedef void        (*hashmap_iter_t)(lmn_key_t, lmn_data_t, void*);
+typedef lmn_word    (*hashmap_slots_t)(lmn_map_t);
+typedef void        (*hashmap_scan_t)(lmn_map_t, lmn_word, lmn_word, hashmap_iter_t, void*);
+typedef void        (*hashmap_find_batch_t)(lmn_map_t, const lmn_key_t*, lmn_data_t*, int);
+typedef void        (*hashmap_bulk_load_t)(lmn_map_t, const lmn_key_t*, const lmn_data_t*, lmn_word, int);
+
+/*
+ * A combiner computes the new value of an entry from its current value
+ * (LMN_HASH_EMPTY_DATA when the key is absent) and the argument of the update.
+ * It may run more than once per update when a CAS loses a race, so it must not
+ * have side effects.
+ */
+typedef lmn_data_t  (*hashmap_combiner_t)(lmn_data_t, lmn_data_t);
+typedef lmn_data_t  (*hashmap_update_t)(lmn_map_t, lmn_key_t, hashmap_combiner_t, lmn_data_t);
+
+struct _hashmap_stats_t;
+typedef void        (*hashmap_stats_range_t)(lmn_map_t, lmn_word, lmn_word, struct _hashmap_stats_t*);
 
 typedef struct _hashmap_impl_t {
   hashmap_find_t find;
   hashmap_put_t put;
   hashmap_init_t init;
   hashmap_free_t free;
+  hashmap_slots_t slots; // number of slots (or buckets) scan ranges refer to
+  hashmap_scan_t scan;   // visits every entry stored in slots [begin, end)
+  hashmap_find_batch_t find_batch; // overlaps the cache misses of a group of finds
+  hashmap_bulk_load_t bulk_load;   // fills the table from arrays of pairs, see hashmap_bulk_load
+  hashmap_update_t update;         // atomic read-modify-write of one value, see hashmap_update
+  hashmap_stats_range_t stats;     // adds the occupancy of slots [begin, end), see hashmap_stats.h
 } hashmap_impl_t;
 
+/* operations as recorded in a trace, see hashmap_trace.h */
+#define HASHMAP_TRACE_FIND 1
+#define HASHMAP_TRACE_PUT  2
+
+struct _hashmap_trace_t;
+struct _hashmap_front_t;
+
 typedef struct _hashmap_t {
   lmn_map_t          data;
   hashmap_impl_t impl;
+  struct _hashmap_trace_t *trace; // NULL unless operations are being recorded
+  struct _hashmap_front_t *front; // per-thread front caches (hashmap_front.h), NULL when off
 } hashmap_t;
 
+void hashmap_trace_record(struct _hashmap_trace_t *trace, int op, lmn_key_t key, lmn_data_t data);
+lmn_data_t hashmap_front_find(hashmap_t *map, lmn_key_t key);
+lmn_data_t hashmap_front_find_or_put(hashmap_t *map, lmn_key_t key, lmn_data_t data);
+void hashmap_front_forget(hashmap_t *map, lmn_key_t key);
+
+typedef int         (*hashset_contains_t)(lmn_map_t, lmn_key_t);
+typedef int         (*hashset_insert_t)(lmn_map_t, lmn_key_t);
+
+typedef struct _hashset_impl_t {
+  hashset_contains_t contains;
+  hashset_insert_t insert;
+  hashmap_init_t init;
+  hashmap_free_t free;
+} hashset_impl_t;
+
+/* keys-only specialization of each engine, no value storage is allocated */
+typedef struct _hashset_t {
+  lmn_map_t          data;
+  hashset_impl_t impl;
+} hashset_t;
+
 void hashmap_init(hashmap_t *map, hashmap_type_t type);
 
 inline lmn_data_t hashmap_find(hashmap_t *map, lmn_key_t key) {
-  return map->impl.find(map->data, key);
+  lmn_data_t data = LMN_UNLIKELY(map->front != NULL) ? hashmap_front_find(map, key) : map->impl.find(map->data, key);
+  if (LMN_UNLIKELY(map->trace != NULL)) hashmap_trace_record(map->trace, HASHMAP_TRACE_FIND, key, data);
+  return data;
 }
 
+/* out[i] = hashmap_find(map, keys[i]), bypassing the front cache; engines without a batched path loop over find */
+void hashmap_find_batch(hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+
 inline void hashmap_put(hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  if (LMN_UNLIKELY(map->trace != NULL)) hashmap_trace_record(map->trace, HASHMAP_TRACE_PUT, key, data);
+  if (LMN_UNLIKELY(map->front != NULL)) hashmap_front_forget(map, key);
   map->impl.put(map->data, key, data);
 }
 
+/*
+ * Atomically replaces the value of key by combiner(value, arg), inserting the key
+ * when it is absent, and returns the previous value. Unlike put this also changes
+ * existing entries of the CC maps. Updates are not recorded in traces.
+ */
+lmn_data_t hashmap_update(hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg);
+
+/*
+ * Returns the value of key if it is present; otherwise puts data and returns
+ * LMN_HASH_EMPTY_DATA, so exactly one of several racing callers sees the key as
+ * new. Engines without update fall back to a find and a put, which is not atomic.
+ */
+lmn_data_t hashmap_find_or_put(hashmap_t *map, lmn_key_t key, lmn_data_t data);
+lmn_data_t hashmap_find_or_put_inner(hashmap_t *map, lmn_key_t key, lmn_data_t data);
+
+/* built-in combiners; values compare as unsigned words and an absent value takes arg */
+lmn_data_t hashmap_combine_set(lmn_data_t value, lmn_data_t arg);
+lmn_data_t hashmap_combine_keep(lmn_data_t value, lmn_data_t arg);
+lmn_data_t hashmap_combine_add(lmn_data_t value, lmn_data_t arg);
+lmn_data_t hashmap_combine_min(lmn_data_t value, lmn_data_t arg);
+lmn_data_t hashmap_combine_max(lmn_data_t value, lmn_data_t arg);
+
+/* adds delta to the counter stored under key (0 when absent) and returns its previous value */
+inline lmn_word hashmap_fetch_add(hashmap_t *map, lmn_key_t key, lmn_word delta) {
+  return (lmn_word)hashmap_update(map, key, hashmap_combine_add, (lmn_data_t)delta);
+}
+
 inline void hashmap_free(hashmap_t *map) {
   map->impl.free(map->data);
 }
 
+void hashset_init(hashset_t *set, hashmap_type_t type);
+void hashmap_bitstate_init(hashmap_t *map, lmn_word nbits, int nhashes);
+void hashset_bitstate_init(hashset_t *set, lmn_word nbits, int nhashes);
+void hashmap_cc_init_with_size(hashmap_t *map, lmn_word slots);
+void hashmap_chain_init_with_lock(hashmap_t *map, int policy);
+void hashmap_tiered_init(hashmap_t *map, lmn_word mem_slots, const char *dir);
+
+/* returns TRUE if the key was added, FALSE if it was already in the set */
+inline int hashset_insert(hashset_t *set, lmn_key_t key) {
+  return set->impl.insert(set->data, key);
+}
+
+inline int hashset_contains(hashset_t *set, lmn_key_t key) {
+  return set->impl.contains(set->data, key);
+}
+
+inline void hashset_free(hashset_t *set) {
+  set->impl.free(set->data);
+}
+
+/*
+ * iteration
+ *
+ * Scans are weakly consistent. Without concurrent writers every entry is
+ * reported exactly once. With them, entries inserted during the scan may or
+ * may not be reported, and for entries inserted before it each engine gives:
+ *   cc, cch32, lfch, tier, frozen: reported exactly once, entries never move
+ *     (tier reports a key buffered for a flush once, against the runs it saw)
+ *   lch, fch: a rehash during the scan may hide entries or report them twice,
+ *     since later chunks walk the old slot range of the new, larger table
+ *   ckh: a key displaced between buckets may be reported twice or missed
+ * hashmap_count, hashmap_export and hashmap_freeze build on scans, so they are
+ * exact only while no other thread writes the map.
+ * Parallel scans split the slot range into HASHMAP_SCAN_CHUNK sized chunks
+ * which the worker threads grab in order, so fn is called concurrently.
+ */
+
+#define HASHMAP_SCAN_CHUNK (1 << 16)
+
+void hashmap_for_each(hashmap_t *map, hashmap_iter_t fn, void *arg);
+void hashmap_parallel_scan(hashmap_t *map, int nthreads, hashmap_iter_t fn, void *arg);
+lmn_word hashmap_count(hashmap_t *map, int nthreads);
+lmn_word hashmap_export(hashmap_t *map, lmn_key_t *keys, lmn_data_t *values, lmn_word capacity, int nthreads);
+
+/*
+ * Puts n pairs using nthreads threads. Engines with a bulk path partition the pairs
+ * by bucket range and fill every range sequentially without atomics; the others
+ * (and traced maps) put slices of the arrays in parallel. The map must not be used
+ * by other threads during the load, and with repeated keys which pair wins is unspecified.
+ */
+void hashmap_bulk_load(hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads);
+
+/* builds a read-only, densely packed snapshot of src into dst; put on dst is an error */
+void hashmap_freeze(hashmap_t *src, hashmap_t *dst, int nthreads);
+
 }
 }
 }
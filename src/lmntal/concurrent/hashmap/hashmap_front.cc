@@ -0,0 +1,105 @@
+/**
+ * @file   hashmap_front.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "hashmap_front.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+/*
+ * private functions
+ */
+
+inline hashmap_front_entry_t *hashmap_front_slot(hashmap_front_t *front, hashmap_front_cache_t *cache, lmn_key_t key) {
+  return &cache->entries[hash<lmn_word>(key) & front->mask];
+}
+
+/* ids are unique among live threads; a recycled id inherits the cache, whose entries stay valid */
+inline hashmap_front_cache_t *hashmap_front_cache(hashmap_front_t *front) {
+  int tid = GetCurrentThreadId();
+  hashmap_front_cache_t *cache = front->caches[tid];
+  if (LMN_UNLIKELY(cache == NULL)) {
+    cache = lmn_malloc(hashmap_front_cache_t);
+    cache->entries = lmn_calloc(hashmap_front_entry_t, front->mask + 1);
+    cache->hits    = 0;
+    cache->lookups = 0;
+    front->caches[tid] = cache;
+  }
+  return cache;
+}
+
+/*
+ * public functions
+ */
+
+void hashmap_front_start(hashmap_t *map, int bits) {
+  hashmap_front_t *front = lmn_calloc(hashmap_front_t, 1);
+  front->mask = ((lmn_word)1 << bits) - 1;
+  map->front  = front;
+}
+
+void hashmap_front_stop(hashmap_t *map) {
+  hashmap_front_t *front = map->front;
+  if (front == NULL) return;
+  map->front = NULL;
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    if (front->caches[i] == NULL) continue;
+    lmn_free(front->caches[i]->entries);
+    lmn_free(front->caches[i]);
+  }
+  lmn_free(front);
+}
+
+void hashmap_front_stats(hashmap_t *map, lmn_word *hits, lmn_word *lookups) {
+  *hits = *lookups = 0;
+  if (map->front == NULL) return;
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    hashmap_front_cache_t *cache = map->front->caches[i];
+    if (cache == NULL) continue;
+    *hits    += cache->hits;
+    *lookups += cache->lookups;
+  }
+}
+
+lmn_data_t hashmap_front_find(hashmap_t *map, lmn_key_t key) {
+  hashmap_front_cache_t *cache = hashmap_front_cache(map->front);
+  hashmap_front_entry_t *e     = hashmap_front_slot(map->front, cache, key);
+  cache->lookups++;
+  if (e->key == key && key != LMN_HASH_EMPTY_KEY) {
+    cache->hits++;
+    return e->data;
+  }
+  lmn_data_t data = map->impl.find(map->data, key);
+  if (data != LMN_HASH_EMPTY_DATA) {
+    e->key  = key;
+    e->data = data;
+  }
+  return data;
+}
+
+void hashmap_front_forget(hashmap_t *map, lmn_key_t key) {
+  hashmap_front_cache_t *cache = hashmap_front_cache(map->front);
+  hashmap_front_entry_t *e     = hashmap_front_slot(map->front, cache, key);
+  if (e->key == key) e->key = LMN_HASH_EMPTY_KEY;
+}
+
+lmn_data_t hashmap_front_find_or_put(hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  hashmap_front_cache_t *cache = hashmap_front_cache(map->front);
+  hashmap_front_entry_t *e     = hashmap_front_slot(map->front, cache, key);
+  cache->lookups++;
+  if (e->key == key && key != LMN_HASH_EMPTY_KEY) {
+    cache->hits++;
+    return e->data;
+  }
+  lmn_data_t old = hashmap_find_or_put_inner(map, key, data);
+  e->key  = key;
+  e->data = (old != LMN_HASH_EMPTY_DATA) ? old : data;
+  return old;
+}
+
+}
+}
+}
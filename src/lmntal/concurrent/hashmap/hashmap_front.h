@@ -0,0 +1,55 @@
+/**
+ * @file   hashmap_front.h
+ * @brief
+ * Per-thread front cache of a hashmap. Every thread gets a small direct-mapped
+ * array of (key, value) pairs it has recently found or inserted; find and
+ * find_or_put look there before touching the shared table, so the duplicates a
+ * thread keeps producing are absorbed in its own cache.
+ * Only hits are cached. A cached value is not refreshed when another thread
+ * changes the entry, so the cache suits maps whose values are written once,
+ * such as state stores; the thread's own puts and updates drop its copy.
+ * A cache is read and written without synchronization by the thread whose id
+ * (GetCurrentThreadId) indexes it, so no two live threads may share an id;
+ * thread.cc guarantees that for every thread, including the main thread.
+ * @author Taketo Yoshida
+ */
+#ifndef HASHMAP_FRONT_H
+#  define HASHMAP_FRONT_H
+
+#include "hashmap.h"
+#include "../thread.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define HASHMAP_FRONT_DEFAULT_BITS 12 // 4096 entries, 64KB per thread
+
+typedef struct {
+  lmn_key_t  key;
+  lmn_data_t data;
+} hashmap_front_entry_t;
+
+typedef struct {
+  hashmap_front_entry_t *entries;
+  lmn_word               hits;
+  lmn_word               lookups;
+} hashmap_front_cache_t;
+
+typedef struct _hashmap_front_t {
+  lmn_word               mask;
+  hashmap_front_cache_t *caches[LMN_MAX_THREADS]; // by thread id, created by their own thread
+} hashmap_front_t;
+
+/* 2^bits entries per thread; start and stop while no thread uses the map */
+void hashmap_front_start(hashmap_t *map, int bits);
+void hashmap_front_stop(hashmap_t *map);
+
+/* lookups served from the caches and all lookups that went through them, over every thread */
+void hashmap_front_stats(hashmap_t *map, lmn_word *hits, lmn_word *lookups);
+
+}
+}
+}
+
+#endif /* ifndef HASHMAP_FRONT_H */
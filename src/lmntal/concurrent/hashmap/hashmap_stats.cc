@@ -0,0 +1,115 @@
+/**
+ * @file   hashmap_stats.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "hashmap_stats.h"
+#include "../thread.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+typedef struct {
+  hashmap_t       *map;
+  lmn_word         slots;
+  lmn_word         stride;
+  lmn_word volatile cursor;  // next chunk index
+  lmn_word volatile visited; // chunks walked
+  hashmap_stats_t *locals;   // one per worker
+} hashmap_stats_state_t;
+
+/*
+ * private functions
+ */
+
+static void hashmap_stats_worker(int index, int nthreads, void *arg) {
+  hashmap_stats_state_t *st    = (hashmap_stats_state_t*)arg;
+  hashmap_stats_t       *local = &st->locals[index];
+  lmn_word chunk, visited = 0;
+  while ((chunk = LMN_ATOMIC_ADD(&st->cursor, 1)) * st->stride * HASHMAP_SCAN_CHUNK < st->slots) {
+    lmn_word begin = chunk * st->stride * HASHMAP_SCAN_CHUNK;
+    lmn_word end   = (st->slots - begin < HASHMAP_SCAN_CHUNK) ? st->slots : begin + HASHMAP_SCAN_CHUNK;
+    st->map->impl.stats(st->map->data, begin, end, local);
+    visited++;
+  }
+  LMN_ATOMIC_ADD(&st->visited, visited);
+}
+
+static void hashmap_stats_scale(lmn_word *v, lmn_word total, lmn_word visited) {
+  *v = (lmn_word)((double)*v * total / visited + 0.5);
+}
+
+/*
+ * public functions
+ */
+
+void hashmap_stats(hashmap_t *map, hashmap_stats_t *out, int nthreads) {
+  hashmap_stats_sampled(map, out, nthreads, 1);
+}
+
+/* counts of the visited chunks are scaled to the whole table */
+void hashmap_stats_sampled(hashmap_t *map, hashmap_stats_t *out, int nthreads, lmn_word stride) {
+  if (map->impl.stats == NULL) {
+    fprintf(stderr, "stats is not supported by this hashmap\n");
+    exit(1);
+  }
+  if (nthreads < 1) nthreads = 1;
+  if (stride < 1) stride = 1;
+  hashmap_stats_state_t st;
+  memset(&st, 0x00, sizeof(hashmap_stats_state_t));
+  st.map    = map;
+  st.slots  = map->impl.slots(map->data);
+  st.stride = stride;
+  st.locals = lmn_calloc(hashmap_stats_t, nthreads);
+  RunParallel(nthreads, hashmap_stats_worker, &st);
+
+  memset(out, 0x00, sizeof(hashmap_stats_t));
+  for (int t = 0; t < nthreads; t++) {
+    hashmap_stats_t *l = &st.locals[t];
+    out->entries   += l->entries;
+    out->allocated += l->allocated;
+    out->committed += l->committed;
+    for (int i = 0; i < HASHMAP_STATS_HIST; i++) {
+      out->fill[i]     += l->fill[i];
+      out->distance[i] += l->distance[i];
+    }
+  }
+  lmn_free(st.locals);
+
+  lmn_word total = (st.slots + HASHMAP_SCAN_CHUNK - 1) / HASHMAP_SCAN_CHUNK;
+  if (st.visited > 0 && st.visited < total) {
+    hashmap_stats_scale(&out->entries, total, st.visited);
+    hashmap_stats_scale(&out->allocated, total, st.visited);
+    hashmap_stats_scale(&out->committed, total, st.visited);
+    for (int i = 0; i < HASHMAP_STATS_HIST; i++) {
+      hashmap_stats_scale(&out->fill[i], total, st.visited);
+      hashmap_stats_scale(&out->distance[i], total, st.visited);
+    }
+  }
+  out->slots           = st.slots;
+  out->load            = st.slots ? (double)out->entries / st.slots : 0.0;
+  out->bytes_per_entry = out->entries ? (double)out->allocated / out->entries : 0.0;
+}
+
+/* histograms stop at their last non-zero bucket */
+void hashmap_stats_print(FILE *fp, const hashmap_stats_t *stats) {
+  fprintf(fp, "stats: %lu entries, %lu slots, load %.3f, %.1f MB allocated, %.1f MB committed, %.1f bytes/entry\n",
+          stats->entries, stats->slots, stats->load,
+          stats->allocated / 1048576.0, stats->committed / 1048576.0, stats->bytes_per_entry);
+  const char    *names[2] = { "fill", "distance" };
+  const lmn_word *hists[2] = { stats->fill, stats->distance };
+  for (int h = 0; h < 2; h++) {
+    int last = HASHMAP_STATS_HIST - 1;
+    while (last > 0 && hists[h][last] == 0) last--;
+    fprintf(fp, "  %-8s", names[h]);
+    for (int i = 0; i <= last; i++) {
+      fprintf(fp, " %d%s:%lu", i, (i == HASHMAP_STATS_HIST - 1) ? "+" : "", hists[h][i]);
+    }
+    fprintf(fp, "\n");
+  }
+}
+
+}
+}
+}
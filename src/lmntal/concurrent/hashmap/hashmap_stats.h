@@ -0,0 +1,56 @@
+/**
+ * @file   hashmap_stats.h
+ * @brief
+ * Occupancy and memory footprint of a hashmap, for sizing tables and picking
+ * engines from data. The table is walked in parallel like a scan, without
+ * blocking writers for longer than a scan does, so the figures of a map in use
+ * are approximate. hashmap_stats_sampled visits only every stride-th chunk of
+ * HASHMAP_SCAN_CHUNK slots and scales the counts up, for periodic sampling.
+ * Committed bytes come from /proc/self/pagemap (lmn_table_committed), which tells
+ * pages the process wrote from those that reads only mapped to the zero page.
+ *
+ * The two histograms per engine:
+ *   fill     : chain map   - buckets by chain length
+ *              open tables - cache lines (cuckoo: buckets) by the entries in them
+ *   distance : chain map   - entries by their position in the chain
+ *              CC maps     - entries by the cache lines probed before theirs
+ *              cuckoo      - entries in their first (0) or second (1) bucket
+ * @author Taketo Yoshida
+ */
+#ifndef HASHMAP_STATS_H
+#  define HASHMAP_STATS_H
+
+#include "hashmap.h"
+#include <stdio.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define HASHMAP_STATS_HIST 16 // histogram buckets, the last one counts larger values
+
+typedef struct _hashmap_stats_t {
+  lmn_word entries;
+  lmn_word slots;           // slots (or buckets) of the table
+  lmn_word allocated;       // bytes of the table arrays and entry nodes
+  lmn_word committed;       // bytes of those on pages actually backed by memory or swap
+  double   load;            // entries per slot
+  double   bytes_per_entry; // allocated bytes per entry
+  lmn_word fill[HASHMAP_STATS_HIST];
+  lmn_word distance[HASHMAP_STATS_HIST];
+} hashmap_stats_t;
+
+inline void hashmap_stats_record(lmn_word *hist, lmn_word value) {
+  hist[(value < HASHMAP_STATS_HIST) ? value : HASHMAP_STATS_HIST - 1]++;
+}
+
+/* the map must support stats; maps without it (tiered, frozen, bitstate) are an error */
+void hashmap_stats(hashmap_t *map, hashmap_stats_t *out, int nthreads);
+void hashmap_stats_sampled(hashmap_t *map, hashmap_stats_t *out, int nthreads, lmn_word stride);
+void hashmap_stats_print(FILE *fp, const hashmap_stats_t *stats);
+
+}
+}
+}
+
+#endif /* ifndef HASHMAP_STATS_H */
@@ -0,0 +1,158 @@
+/**
+ * @file   hashmap_trace.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "hashmap_trace.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define HASHMAP_TRACE_MAGIC_LEN   8
+#define HASHMAP_TRACE_HEADER_SIZE (HASHMAP_TRACE_MAGIC_LEN + 2 * sizeof(uint32_t))
+
+/*
+ * private functions
+ */
+
+void hashmap_trace_fail(const char *what, const char *path) {
+  fprintf(stderr, "trace %s: %s failed\n", path, what);
+  exit(1);
+}
+
+void hashmap_trace_spill(hashmap_trace_t *trace, hashmap_trace_stream_t *s) {
+  if (s->spill == NULL && (s->spill = tmpfile()) == NULL) hashmap_trace_fail("tmpfile", trace->path);
+  if (fwrite(s->records, sizeof(hashmap_trace_record_t), s->n, s->spill) != (size_t)s->n) {
+    hashmap_trace_fail("write", trace->path);
+  }
+  s->n = 0;
+}
+
+void hashmap_trace_copy(hashmap_trace_t *trace, hashmap_trace_stream_t *s, FILE *out) {
+  if (s->spill != NULL) {
+    char buf[1 << 16];
+    size_t n;
+    rewind(s->spill);
+    while ((n = fread(buf, 1, sizeof(buf), s->spill)) > 0) {
+      if (fwrite(buf, 1, n, out) != n) hashmap_trace_fail("write", trace->path);
+    }
+    fclose(s->spill);
+  }
+  if (fwrite(s->records, sizeof(hashmap_trace_record_t), s->n, out) != (size_t)s->n) {
+    hashmap_trace_fail("write", trace->path);
+  }
+}
+
+/*
+ * public functions
+ */
+
+/* called through hashmap_find/hashmap_put while a trace is attached */
+void hashmap_trace_record(hashmap_trace_t *trace, int op, lmn_key_t key, lmn_data_t data) {
+  hashmap_trace_stream_t *s = trace->streams[GetCurrentThreadId()];
+  if (LMN_UNLIKELY(s == NULL)) {
+    s = lmn_calloc(hashmap_trace_stream_t, 1);
+    s->records = lmn_calloc(hashmap_trace_record_t, HASHMAP_TRACE_BUFFER);
+    trace->streams[GetCurrentThreadId()] = s;
+  }
+  if (LMN_UNLIKELY(s->n >= HASHMAP_TRACE_BUFFER)) hashmap_trace_spill(trace, s);
+  hashmap_trace_record_t *r = &s->records[s->n++];
+  r->op   = (uint8_t)op;
+  r->key  = (uint64_t)key;
+  r->data = (uint64_t)data;
+  s->count++;
+}
+
+/* records every following find and put on map until hashmap_trace_stop */
+hashmap_trace_t *hashmap_trace_start(hashmap_t *map, const char *path) {
+  hashmap_trace_t *trace = lmn_calloc(hashmap_trace_t, 1);
+  trace->path = strdup(path);
+  map->trace  = trace;
+  return trace;
+}
+
+/* detaches the recorder and writes the trace file; no operation on map may be in flight */
+void hashmap_trace_stop(hashmap_t *map) {
+  hashmap_trace_t *trace = map->trace;
+  if (trace == NULL) return;
+  map->trace = NULL;
+
+  FILE *out = fopen(trace->path, "wb");
+  if (out == NULL) hashmap_trace_fail("open", trace->path);
+  uint32_t header[2] = { HASHMAP_TRACE_VERSION, 0 };
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    if (trace->streams[i] != NULL) header[1]++;
+  }
+  uint64_t offset = HASHMAP_TRACE_HEADER_SIZE + header[1] * 2 * sizeof(uint64_t);
+  if (fwrite(HASHMAP_TRACE_MAGIC, 1, HASHMAP_TRACE_MAGIC_LEN, out) != HASHMAP_TRACE_MAGIC_LEN ||
+      fwrite(header, sizeof(uint32_t), 2, out) != 2) {
+    hashmap_trace_fail("write", trace->path);
+  }
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    hashmap_trace_stream_t *s = trace->streams[i];
+    if (s == NULL) continue;
+    uint64_t entry[2] = { offset, s->count };
+    if (fwrite(entry, sizeof(uint64_t), 2, out) != 2) hashmap_trace_fail("write", trace->path);
+    offset += s->count * sizeof(hashmap_trace_record_t);
+  }
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    hashmap_trace_stream_t *s = trace->streams[i];
+    if (s == NULL) continue;
+    hashmap_trace_copy(trace, s, out);
+    lmn_free(s->records);
+    lmn_free(s);
+  }
+  if (fclose(out) != 0) hashmap_trace_fail("close", trace->path);
+  free(trace->path);
+  lmn_free(trace);
+}
+
+/* maps a trace file with its pages populated up front; returns FALSE if it is not a trace */
+int hashmap_trace_map(hashmap_trace_file_t *file, const char *path) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return FALSE;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < HASHMAP_TRACE_HEADER_SIZE) {
+    close(fd);
+    return FALSE;
+  }
+  file->size = st.st_size;
+  file->base = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (file->base == MAP_FAILED) return FALSE;
+
+  uint32_t *header = (uint32_t*)((char*)file->base + HASHMAP_TRACE_MAGIC_LEN);
+  file->nstreams = header[1];
+  file->index    = (uint64_t*)((char*)file->base + HASHMAP_TRACE_HEADER_SIZE);
+  if (memcmp(file->base, HASHMAP_TRACE_MAGIC, HASHMAP_TRACE_MAGIC_LEN) != 0 || header[0] != HASHMAP_TRACE_VERSION ||
+      HASHMAP_TRACE_HEADER_SIZE + file->nstreams * 2 * sizeof(uint64_t) > file->size) {
+    munmap(file->base, file->size);
+    return FALSE;
+  }
+  for (uint32_t i = 0; i < file->nstreams; i++) {
+    if (file->index[2 * i] + file->index[2 * i + 1] * sizeof(hashmap_trace_record_t) > file->size) {
+      munmap(file->base, file->size);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* returns the number of records of stream and points records at the first one */
+uint64_t hashmap_trace_stream(hashmap_trace_file_t *file, int stream, const hashmap_trace_record_t **records) {
+  LMN_PTR_VAL(records) = (const hashmap_trace_record_t*)((char*)file->base + file->index[2 * stream]);
+  return file->index[2 * stream + 1];
+}
+
+void hashmap_trace_unmap(hashmap_trace_file_t *file) {
+  munmap(file->base, file->size);
+}
+
+}
+}
+}
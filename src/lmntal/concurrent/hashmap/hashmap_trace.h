@@ -0,0 +1,67 @@
+/**
+ * @file   hashmap_trace.h
+ * @brief
+ * Recording and replaying hashmap operations. A trace file holds one stream of
+ * (op, key, data) records per recording thread, 17 bytes per record:
+ *
+ *   header  : "LMNTRACE", uint32 version, uint32 nstreams
+ *   streams : nstreams x { uint64 offset, uint64 count }
+ *   records : packed hashmap_trace_record_t, stream after stream
+ *
+ * While recording, every thread appends to its own buffer, so the hook costs no
+ * synchronization. Replay maps the file and hands out the streams in place.
+ * @author Taketo Yoshida
+ */
+#ifndef HASHMAP_TRACE_H
+#  define HASHMAP_TRACE_H
+
+#include "hashmap.h"
+#include "../thread.h"
+#include <stdint.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define HASHMAP_TRACE_MAGIC   "LMNTRACE"
+#define HASHMAP_TRACE_VERSION 1
+#define HASHMAP_TRACE_BUFFER  (1 << 16) // records buffered per thread before they go to disk
+
+typedef struct __attribute__((packed)) {
+  uint8_t  op;
+  uint64_t key;
+  uint64_t data;
+} hashmap_trace_record_t;
+
+typedef struct {
+  hashmap_trace_record_t *records;
+  int                     n;
+  FILE                   *spill; // anonymous temporary file, NULL until the buffer first fills
+  uint64_t                count;
+} hashmap_trace_stream_t;
+
+typedef struct _hashmap_trace_t {
+  char                   *path;
+  hashmap_trace_stream_t *streams[LMN_MAX_THREADS]; // by thread id, created by their own thread
+} hashmap_trace_t;
+
+typedef struct {
+  void     *base;
+  size_t    size;
+  uint32_t  nstreams;
+  uint64_t *index; // offset and count of every stream
+} hashmap_trace_file_t;
+
+hashmap_trace_t *hashmap_trace_start(hashmap_t *map, const char *path);
+void hashmap_trace_stop(hashmap_t *map);
+
+int hashmap_trace_map(hashmap_trace_file_t *file, const char *path);
+uint64_t hashmap_trace_stream(hashmap_trace_file_t *file, int stream, const hashmap_trace_record_t **records);
+void hashmap_trace_unmap(hashmap_trace_file_t *file);
+
+}
+}
+}
+
+#endif /* ifndef HASHMAP_TRACE_H */
+
@@ -4,84 +4,209 @@
  * @author Taketo Yoshida
  */
 #include "lf_chain_hashmap.h"
+#include "table_alloc.h"
+#include "bulk_load.h"
+#include "hashmap_stats.h"
 #include "../thread.h"
 
 namespace lmntal {
 namespace concurrent {
 namespace hashmap {
 
+/*
+ * Every bucket is a list sorted by key. Nodes are never removed, so a link
+ * once seen stays valid and an insert is a single CAS of the link in front of
+ * the first larger node (a Harris list without the deletion marks).
+ */
+
+/*
+ * private functions
+ */
+
+/*
+ * Walks from *link to the first node whose key is not smaller than key and
+ * leaves link pointing at the pointer to it. The next node is prefetched
+ * before the current one is compared, overlapping the dependent misses.
+ */
+template <typename T>
+inline T *lf_chain_seek(T * volatile **link, lmn_key_t key) {
+  T *cur = **link;
+  while (cur != LMN_HASH_EMPTY) {
+    T *next = cur->next;
+    LMN_PREFETCH(next, 0, 3);
+    if (cur->key >= key) break;
+    *link = &cur->next;
+    cur   = next;
+  }
+  return cur;
+}
+
+typedef struct {
+  chain_hashmap_t  *map;
+  bulk_partition_t *p;
+} lf_chain_bulk_t;
+
+/*
+ * The same seek as a put, with a plain store in place of the CAS. Like put it
+ * leaves size alone: the table never resizes, and a shared counter would be
+ * the one contended word of every insert.
+ */
+void lf_chain_bulk_worker(int index, int nthreads, void *arg) {
+  lf_chain_bulk_t  *b     = (lf_chain_bulk_t*)arg;
+  bulk_partition_t *p     = b->p;
+  int part;
+  while ((part = bulk_next_partition(p)) >= 0) {
+    lmn_word begin = p->parts[part], end = p->parts[part + 1];
+    if (begin == end) continue;
+    chain_entry_t *block = lmn_calloc(chain_entry_t, end - begin);
+    lmn_word       used  = 0;
+    for (lmn_word i = begin; i < end; i++) {
+      lmn_key_t key = p->keys[i];
+      chain_entry_t * volatile *link = &b->map->tbl[bulk_bucket(p, key)];
+      chain_entry_t *cur = lf_chain_seek(&link, key);
+      if (cur != LMN_HASH_EMPTY && cur->key == key) {
+        cur->data = p->values[i];
+        continue;
+      }
+      chain_entry_t *ent = &block[used++];
+      ent->key  = key;
+      ent->data = p->values[i];
+      ent->next = cur;
+      *link     = ent;
+    }
+    if (used == 0) lmn_free(block);
+  }
+}
+
 /*
  * public functions
  */
 
 void lf_chain_init(chain_hashmap_t* map) {
-  map->tbl              = (chain_entry_t**)calloc(sizeof(chain_entry_t*), LMN_DEFAULT_SIZE);
+  map->tbl              = lmn_table_calloc(chain_entry_t*, LMN_DEFAULT_SIZE);
   map->bucket_mask      = LMN_DEFAULT_SIZE- 1;
   map->size             = 0;
-  memset(map->tbl, 0x00, LMN_DEFAULT_SIZE);
 }
 
+/* a miss stops at the first larger key */
 lmn_data_t lf_chain_find(chain_hashmap_t *map, lmn_key_t key) {
-  lmn_word bucket     = hash<lmn_word>(key) & map->bucket_mask;
-  chain_entry_t *ent  = map->tbl[bucket];
-  chain_entry_t *old;
+  lmn_word bucket = hash<lmn_word>(key) & map->bucket_mask;
+  chain_entry_t * volatile *link = &map->tbl[bucket];
+  chain_entry_t *ent = lf_chain_seek(&link, key);
+  return (ent != LMN_HASH_EMPTY && ent->key == key) ? ent->data : NULL;
+}
+
+void lf_chain_free(chain_hashmap_t* map) {
+
+}
 
-  while(ent != LMN_HASH_EMPTY) {
-    if (ent->key == key) {
-      return ent->data;
+lmn_word lf_chain_slots(chain_hashmap_t *map) {
+  return map->bucket_mask + 1;
+}
+
+void lf_chain_scan(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  chain_entry_t **tbl = map->tbl;
+  for (lmn_word i = begin; i < end; i++) {
+    for (chain_entry_t *ent = tbl[i]; ent != LMN_HASH_EMPTY; ent = ent->next) {
+      fn(ent->key, ent->data, arg);
     }
-    ent = ent->next;
   }
-  return NULL;
 }
 
-void lf_chain_free(chain_hashmap_t* map) {
+void lf_chain_stats(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_stats_t *out) {
+  chain_entry_t **tbl = map->tbl;
+  out->allocated += (end - begin) * sizeof(chain_entry_t*);
+  out->committed += lmn_table_committed(&tbl[begin], (end - begin) * sizeof(chain_entry_t*));
+  for (lmn_word i = begin; i < end; i++) {
+    chain_stats_bucket(tbl[i], out);
+  }
+}
 
+void lf_chain_find_batch(chain_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  chain_find_interleaved(map->tbl, map->bucket_mask, keys, out, n, TRUE);
 }
 
-void lf_chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
-  lmn_word bucket        = hash<lmn_word>(key) & map->bucket_mask;
-  chain_entry_t **ent    = &map->tbl[bucket];
+void lf_chain_bulk_load(chain_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads) {
+  bulk_partition_t p;
+  lf_chain_bulk_t  b = { map, &p };
+  bulk_partition(&p, keys, values, n, map->bucket_mask, 0, nthreads);
+  RunParallel(nthreads, lf_chain_bulk_worker, &b);
+  bulk_partition_free(&p);
+}
 
-  if ((*ent) == LMN_HASH_EMPTY) {
-    chain_entry_t *tmp, *new_ent = NULL;
-    tmp = *ent;
+/* the node is complete before the CAS publishes it; an existing key gets its data overwritten */
+void lf_chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  lmn_word bucket = hash<lmn_word>(key) & map->bucket_mask;
+  chain_entry_t * volatile *link = &map->tbl[bucket];
+  chain_entry_t *new_ent = NULL, *cur;
+  for (;;) {
+    cur = lf_chain_seek(&link, key);
+    if (cur != LMN_HASH_EMPTY && cur->key == key) {
+      cur->data = data;
+      if (new_ent != NULL) lmn_free(new_ent);
+      return;
+    }
     if (new_ent == NULL) {
-      new_ent = (chain_entry_t*)malloc(sizeof(chain_entry_t));
-      new_ent->next = NULL;
-      if(!LMN_CAS(&(*ent), NULL, new_ent)) {
-        if (new_ent == NULL) free(new_ent);
-        return lf_chain_put(map, key, data);
-      }
-    } else {
-      return lf_chain_put(map, key, data);
+      new_ent       = lmn_malloc(chain_entry_t);
+      new_ent->key  = key;
+      new_ent->data = data;
     }
-  } else {
-    chain_entry_t *cur, *tmp, *new_ent = NULL;
-    cur = *ent;
-    do {
-      tmp = *ent;
-      do {
-        if (cur->key == key) {
-          cur->data = data;
-          if (new_ent == NULL) free(new_ent);
-          return;
-        }
-        //LMN_DBG("[debug] cc_hashmap_put_inner: retry hash, key %u, thread:%d\n", key, GetCurrentThreadId());
-        //printf("%p ", cur->next);
-      } while(cur->next != LMN_HASH_EMPTY && (cur = cur->next));
-      if (new_ent == NULL)
-        new_ent = (chain_entry_t*)malloc(sizeof(chain_entry_t));
-      new_ent->next = (*ent);
-    } while(!LMN_CAS(&(*ent), tmp, new_ent));
-    // dbgprint("insert key:%d, data:%d\n", key, data);
+    new_ent->next = cur;
+    // on failure a node went in right here, so the walk resumes from the same link
+    if (LMN_CAS(link, cur, new_ent)) return;
   }
-  (*ent)->key  = key;
-  (*ent)->data = data;
-  //LMN_ATOMIC_ADD(&(map->size), 1);
 }
 
+/* an existing value is replaced by a CAS loop, a missing key goes in like a put */
+lmn_data_t lf_chain_update(chain_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg) {
+  lmn_word bucket = hash<lmn_word>(key) & map->bucket_mask;
+  chain_entry_t * volatile *link = &map->tbl[bucket];
+  chain_entry_t *new_ent = NULL, *cur;
+  for (;;) {
+    cur = lf_chain_seek(&link, key);
+    if (cur != LMN_HASH_EMPTY && cur->key == key) {
+      if (new_ent != NULL) lmn_free(new_ent);
+      for (;;) {
+        lmn_data_t old = cur->data;
+        if (LMN_CAS(&cur->data, old, combiner(old, arg))) return old;
+      }
+    }
+    if (new_ent == NULL) {
+      new_ent       = lmn_malloc(chain_entry_t);
+      new_ent->key  = key;
+      new_ent->data = combiner(LMN_HASH_EMPTY_DATA, arg);
+    }
+    new_ent->next = cur;
+    if (LMN_CAS(link, cur, new_ent)) return LMN_HASH_EMPTY_DATA;
+  }
 }
+
+int lf_chain_set_contains(chain_hashmap_t *map, lmn_key_t key) {
+  lmn_word bucket = hash<lmn_word>(key) & map->bucket_mask;
+  chain_set_entry_t * volatile *link = (chain_set_entry_t * volatile *)&map->tbl[bucket];
+  chain_set_entry_t *ent = lf_chain_seek(&link, key);
+  return ent != LMN_HASH_EMPTY && ent->key == key;
 }
+
+int lf_chain_set_insert(chain_hashmap_t *map, lmn_key_t key) {
+  lmn_word bucket = hash<lmn_word>(key) & map->bucket_mask;
+  chain_set_entry_t * volatile *link = (chain_set_entry_t * volatile *)&map->tbl[bucket];
+  chain_set_entry_t *new_ent = NULL, *cur;
+  for (;;) {
+    cur = lf_chain_seek(&link, key);
+    if (cur != LMN_HASH_EMPTY && cur->key == key) {
+      if (new_ent != NULL) lmn_free(new_ent);
+      return FALSE;
+    }
+    if (new_ent == NULL) {
+      new_ent      = lmn_malloc(chain_set_entry_t);
+      new_ent->key = key;
+    }
+    new_ent->next = cur;
+    if (LMN_CAS(link, cur, new_ent)) return TRUE;
+  }
 }
 
+}
+}
+}
@@ -15,7 +15,16 @@ namespace hashmap {
 void lf_chain_init(chain_hashmap_t* map);
 lmn_data_t lf_chain_find(chain_hashmap_t *map, lmn_key_t key);
 void lf_chain_put(chain_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+lmn_data_t lf_chain_update(chain_hashmap_t *map, lmn_key_t key, hashmap_combiner_t combiner, lmn_data_t arg);
 void lf_chain_free(chain_hashmap_t* map);
+lmn_word lf_chain_slots(chain_hashmap_t *map);
+void lf_chain_scan(chain_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+void lf_chain_find_batch(chain_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+void lf_chain_stats(chain_hashmap_t *map, lmn_word begin, lmn_word end, struct _hashmap_stats_t *out);
+void lf_chain_bulk_load(chain_hashmap_t *map, const lmn_key_t *keys, const lmn_data_t *values, lmn_word n, int nthreads);
+
+int lf_chain_set_contains(chain_hashmap_t *map, lmn_key_t key);
+int lf_chain_set_insert(chain_hashmap_t *map, lmn_key_t key);
 
 }
 }
@@ -0,0 +1,91 @@
+/**
+ * @file   local_hashmap.cc
+ * @brief  
+ * @author Taketo Yoshida
+ */
+#include "local_hashmap.h"
+#include "table_alloc.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+/*
+ * private functions
+ */
+
+inline lmn_word local_lookup(local_hashmap_t *map, lmn_key_t key) {
+  lmn_word i = hash<lmn_word>(key) & map->bucket_mask;
+  while (map->keys[i] != LMN_HASH_EMPTY_KEY && map->keys[i] != key) {
+    i = (i + 1) & map->bucket_mask;
+  }
+  return i;
+}
+
+void local_grow(local_hashmap_t *map) {
+  lmn_key_t  *old_keys = map->keys;
+  lmn_data_t *old_data = map->data;
+  lmn_word    old_size = map->bucket_mask + 1;
+
+  local_init(map, old_size << 1);
+  for (lmn_word i = 0; i < old_size; i++) {
+    if (old_keys[i] != LMN_HASH_EMPTY_KEY) {
+      lmn_word j = local_lookup(map, old_keys[i]);
+      map->keys[j] = old_keys[i];
+      map->data[j] = old_data[i];
+      map->count++;
+    }
+  }
+  lmn_table_free(old_keys, lmn_key_t, old_size);
+  lmn_table_free(old_data, lmn_data_t, old_size);
+}
+
+/*
+ * public functions
+ */
+
+/* size must be a power of two */
+void local_init(local_hashmap_t *map, lmn_word size) {
+  map->keys        = lmn_table_calloc(lmn_key_t, size);
+  map->data        = lmn_table_calloc(lmn_data_t, size);
+  map->bucket_mask = size - 1;
+  map->count       = 0;
+}
+
+lmn_data_t local_find(local_hashmap_t *map, lmn_key_t key) {
+  lmn_word i = local_lookup(map, key);
+  return (map->keys[i] == key) ? map->data[i] : LMN_HASH_EMPTY_DATA;
+}
+
+int local_contains(local_hashmap_t *map, lmn_key_t key) {
+  return map->keys[local_lookup(map, key)] == key;
+}
+
+/* returns TRUE if the key was new; an existing key gets its data overwritten */
+int local_put(local_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  lmn_word i = local_lookup(map, key);
+  map->data[i] = data;
+  if (map->keys[i] == key) return FALSE;
+  map->keys[i] = key;
+  if (++map->count > (map->bucket_mask >> 1)) local_grow(map);
+  return TRUE;
+}
+
+void local_free(local_hashmap_t *map) {
+  lmn_table_free(map->keys, lmn_key_t, local_slots(map));
+  lmn_table_free(map->data, lmn_data_t, local_slots(map));
+}
+
+lmn_word local_slots(local_hashmap_t *map) {
+  return map->bucket_mask + 1;
+}
+
+void local_scan(local_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  for (lmn_word i = begin; i < end; i++) {
+    if (map->keys[i] != LMN_HASH_EMPTY_KEY) fn(map->keys[i], map->data[i], arg);
+  }
+}
+
+}
+}
+}
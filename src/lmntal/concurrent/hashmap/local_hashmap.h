@@ -0,0 +1,40 @@
+/**
+ * @file   local_hashmap.h
+ * @brief
+ * Single-threaded open addressing table (linear probing, doubling at half load).
+ * No atomics and no locks: it backs structures where exactly one thread owns the
+ * table, such as the shards of the sharded map.
+ * @author Taketo Yoshida
+ */
+#ifndef LOCAL_HASHMAP_H
+#  define LOCAL_HASHMAP_H
+
+#include "hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define LOCAL_HASHMAP_DEFAULT_SIZE (1 << 16)
+
+typedef struct {
+  lmn_key_t  *keys;
+  lmn_data_t *data;
+  lmn_word    bucket_mask;
+  lmn_word    count;
+} local_hashmap_t;
+
+void local_init(local_hashmap_t *map, lmn_word size);
+lmn_data_t local_find(local_hashmap_t *map, lmn_key_t key);
+int local_put(local_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+int local_contains(local_hashmap_t *map, lmn_key_t key);
+void local_free(local_hashmap_t *map);
+lmn_word local_slots(local_hashmap_t *map);
+void local_scan(local_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+
+}
+}
+}
+
+#endif /* ifndef LOCAL_HASHMAP_H */
+
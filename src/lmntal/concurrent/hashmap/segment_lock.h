@@ -0,0 +1,234 @@
+/**
+ * @file   segment_lock.h
+ * @brief
+ * Lock policies for the segments of the striped chain map. Critical sections there
+ * are a few dozen nanoseconds long, so spinning usually beats sleeping in the kernel:
+ *
+ *   mutex  : pthread mutex, the original behaviour
+ *   ttas   : test-and-test-and-set spinlock with exponential backoff
+ *   ticket : FIFO ticket lock, fair under contention
+ *   mcs    : MCS queue lock, every waiter spins on its own cache line
+ *   rw     : reader-writer spinlock with writer preference; finds share the segment
+ *
+ * Every lock takes a cache line of its own. The operations are overloaded on the
+ * lock type so that the chain map can be instantiated once per policy.
+ * MCS : J. M. Mellor-Crummey, M. L. Scott, "Algorithms for Scalable Synchronization on Shared-Memory Multiprocessors", TOCS 1991
+ * @author Taketo Yoshida
+ */
+#ifndef SEGMENT_LOCK_H
+#  define SEGMENT_LOCK_H
+
+#include "hashmap.h"
+#include "../thread.h"
+#include <sched.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+typedef enum {
+  LMN_LOCK_MUTEX = 0,
+  LMN_LOCK_TTAS,
+  LMN_LOCK_TICKET,
+  LMN_LOCK_MCS,
+  LMN_LOCK_RW
+} lmn_lock_policy_t;
+
+#define LMN_LOCK_MIN_BACKOFF 4
+#define LMN_LOCK_MAX_BACKOFF 1024
+#define LMN_LOCK_YIELD_SPINS 256 // spins before a waiter gives up its core, for more threads than cores
+
+#define LMN_RW_WRITER  (1 << 30)
+#define LMN_RW_READERS (LMN_RW_WRITER - 1)
+
+typedef struct {
+  pthread_mutex_t m;
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) lmn_mutex_lock_t;
+
+typedef struct {
+  int volatile state;
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) lmn_ttas_lock_t;
+
+typedef struct {
+  unsigned int volatile next;
+  unsigned int volatile owner;
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) lmn_ticket_lock_t;
+
+typedef struct _lmn_mcs_node_t {
+  struct _lmn_mcs_node_t * volatile next;
+  int                      volatile locked;
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) lmn_mcs_node_t;
+
+typedef struct {
+  lmn_mcs_node_t * volatile tail;
+  lmn_mcs_node_t           *nodes; // queue node of every thread id for this lock
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) lmn_mcs_lock_t;
+
+typedef struct {
+  int volatile state; // LMN_RW_WRITER while a writer holds or waits for it, plus the number of readers
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) lmn_rw_spinlock_t;
+
+/* one spin of a wait loop; a FIFO lock would otherwise stall whenever the next owner is preempted */
+inline void lmn_lock_spin(int *spins) {
+  LMN_CPU_RELAX();
+  if (++*spins >= LMN_LOCK_YIELD_SPINS) {
+    *spins = 0;
+    sched_yield();
+  }
+}
+
+/*
+ * mutex
+ */
+
+inline void lmn_lock_init(lmn_mutex_lock_t *l) {
+  pthread_mutexattr_t mattr;
+  pthread_mutexattr_init(&mattr);
+  pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+  pthread_mutex_init(&l->m, &mattr);
+}
+
+inline void lmn_lock_destroy(lmn_mutex_lock_t *l) { pthread_mutex_destroy(&l->m); }
+inline void lmn_lock_acquire(lmn_mutex_lock_t *l) { pthread_mutex_lock(&l->m); }
+inline void lmn_lock_release(lmn_mutex_lock_t *l) { pthread_mutex_unlock(&l->m); }
+inline int lmn_lock_try(lmn_mutex_lock_t *l)      { return pthread_mutex_trylock(&l->m) == 0; }
+
+/*
+ * test-and-test-and-set
+ */
+
+inline void lmn_lock_init(lmn_ttas_lock_t *l)    { l->state = 0; }
+inline void lmn_lock_destroy(lmn_ttas_lock_t *l) {}
+
+inline void lmn_lock_acquire(lmn_ttas_lock_t *l) {
+  int backoff = LMN_LOCK_MIN_BACKOFF, spins = 0;
+  for (;;) {
+    while (l->state) lmn_lock_spin(&spins);
+    if (__sync_lock_test_and_set(&l->state, 1) == 0) return;
+    for (int i = 0; i < backoff; i++) lmn_lock_spin(&spins);
+    if (backoff < LMN_LOCK_MAX_BACKOFF) backoff <<= 1;
+  }
+}
+
+inline void lmn_lock_release(lmn_ttas_lock_t *l) { __sync_lock_release(&l->state); }
+inline int lmn_lock_try(lmn_ttas_lock_t *l)      { return !l->state && __sync_lock_test_and_set(&l->state, 1) == 0; }
+
+/*
+ * ticket
+ */
+
+inline void lmn_lock_init(lmn_ticket_lock_t *l)    { l->next = l->owner = 0; }
+inline void lmn_lock_destroy(lmn_ticket_lock_t *l) {}
+
+/* waiters back off in proportion to their distance from the head of the queue */
+inline void lmn_lock_acquire(lmn_ticket_lock_t *l) {
+  unsigned int ticket = LMN_ATOMIC_ADD(&l->next, 1);
+  unsigned int owner;
+  int spins = 0;
+  while ((owner = l->owner) != ticket) {
+    for (unsigned int i = 0; i < (ticket - owner) * LMN_LOCK_MIN_BACKOFF; i++) lmn_lock_spin(&spins);
+  }
+  LMN_COMPILER_BARRIER();
+}
+
+inline void lmn_lock_release(lmn_ticket_lock_t *l) {
+  LMN_COMPILER_BARRIER();
+  l->owner = l->owner + 1;
+}
+
+inline int lmn_lock_try(lmn_ticket_lock_t *l) {
+  unsigned int owner = l->owner;
+  return l->next == owner && LMN_CAS(&l->next, owner, owner + 1);
+}
+
+/*
+ * MCS; a thread may hold several locks at once since every lock has its own nodes
+ */
+
+inline void lmn_lock_init(lmn_mcs_lock_t *l) {
+  l->tail = NULL;
+  if (posix_memalign((void**)&l->nodes, LMN_CACHE_LINE_SIZE, sizeof(lmn_mcs_node_t) * LMN_MAX_THREADS) != 0) {
+    fprintf(stderr, "failed to allocate lock queue nodes\n");
+    exit(1);
+  }
+  memset(l->nodes, 0x00, sizeof(lmn_mcs_node_t) * LMN_MAX_THREADS);
+}
+
+inline void lmn_lock_destroy(lmn_mcs_lock_t *l) { lmn_free(l->nodes); }
+
+inline void lmn_lock_acquire(lmn_mcs_lock_t *l) {
+  lmn_mcs_node_t *me = &l->nodes[GetCurrentThreadId()];
+  me->next   = NULL;
+  me->locked = 1;
+  lmn_mcs_node_t *pred = __sync_lock_test_and_set(&l->tail, me);
+  if (pred != NULL) {
+    int spins = 0;
+    pred->next = me;
+    while (me->locked) lmn_lock_spin(&spins);
+  }
+  LMN_COMPILER_BARRIER();
+}
+
+inline void lmn_lock_release(lmn_mcs_lock_t *l) {
+  lmn_mcs_node_t *me = &l->nodes[GetCurrentThreadId()];
+  LMN_COMPILER_BARRIER();
+  if (me->next == NULL) {
+    if (LMN_CAS(&l->tail, me, (lmn_mcs_node_t*)NULL)) return;
+    int spins = 0;
+    while (me->next == NULL) lmn_lock_spin(&spins);
+  }
+  me->next->locked = 0;
+}
+
+inline int lmn_lock_try(lmn_mcs_lock_t *l) {
+  lmn_mcs_node_t *me = &l->nodes[GetCurrentThreadId()];
+  me->next   = NULL;
+  me->locked = 1;
+  return LMN_CAS(&l->tail, (lmn_mcs_node_t*)NULL, me);
+}
+
+/*
+ * reader-writer spin; a writer first blocks new readers, then waits for the old ones to leave
+ */
+
+inline void lmn_lock_init(lmn_rw_spinlock_t *l)    { l->state = 0; }
+inline void lmn_lock_destroy(lmn_rw_spinlock_t *l) {}
+
+inline void lmn_lock_acquire(lmn_rw_spinlock_t *l) {
+  int spins = 0;
+  for (;;) {
+    int s = l->state;
+    if (!(s & LMN_RW_WRITER) && LMN_CAS(&l->state, s, s | LMN_RW_WRITER)) break;
+    lmn_lock_spin(&spins);
+  }
+  while (l->state & LMN_RW_READERS) lmn_lock_spin(&spins);
+  LMN_COMPILER_BARRIER();
+}
+
+inline void lmn_lock_release(lmn_rw_spinlock_t *l) { LMN_ATOMIC_SUB(&l->state, LMN_RW_WRITER); }
+
+inline int lmn_lock_try(lmn_rw_spinlock_t *l) { return l->state == 0 && LMN_CAS(&l->state, 0, LMN_RW_WRITER); }
+
+inline void lmn_lock_acquire_shared(lmn_rw_spinlock_t *l) {
+  int spins = 0;
+  for (;;) {
+    int s = l->state;
+    if (!(s & LMN_RW_WRITER) && LMN_CAS(&l->state, s, s + 1)) return;
+    lmn_lock_spin(&spins);
+  }
+}
+
+inline void lmn_lock_release_shared(lmn_rw_spinlock_t *l) { LMN_ATOMIC_SUB(&l->state, 1); }
+
+/* every other policy has no shared mode */
+template <typename L>
+inline void lmn_lock_acquire_shared(L *l) { lmn_lock_acquire(l); }
+
+template <typename L>
+inline void lmn_lock_release_shared(L *l) { lmn_lock_release(l); }
+
+}
+}
+}
+
+#endif /* ifndef SEGMENT_LOCK_H */
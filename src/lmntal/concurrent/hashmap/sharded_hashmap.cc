@@ -0,0 +1,150 @@
+/**
+ * @file   sharded_hashmap.cc
+ * @brief  
+ * @author Taketo Yoshida
+ */
+#include "sharded_hashmap.h"
+#include <sched.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define SHARD_QUEUE_MASK (SHARD_QUEUE_BATCHES - 1)
+
+/*
+ * private functions
+ */
+
+inline shard_queue_t *shard_queue(sharded_hashmap_t *map, int src, int dst) {
+  return &map->queues[src * map->nshards + dst];
+}
+
+inline void shard_apply(shard_t *shard, lmn_key_t key, lmn_data_t data) {
+  if (local_put(&shard->table, key, data)) shard->inserted++;
+}
+
+/* the next batch to fill, waiting (and draining the own inbox) while the queue is full */
+shard_batch_t *shard_queue_reserve(sharded_hashmap_t *map, int worker, shard_queue_t *q) {
+  while (q->tail - q->head == SHARD_QUEUE_BATCHES) {
+    if (sharded_poll(map, worker) == 0) sched_yield();
+  }
+  return &q->ring[q->tail & SHARD_QUEUE_MASK];
+}
+
+inline void shard_queue_publish(shard_queue_t *q) {
+  LMN_COMPILER_BARRIER();
+  q->tail = q->tail + 1;
+}
+
+/*
+ * public functions
+ */
+
+void sharded_init(sharded_hashmap_t *map, int nshards) {
+  map->nshards  = nshards;
+  map->finished = 0;
+  if (posix_memalign((void**)&map->shards, LMN_CACHE_LINE_SIZE, sizeof(shard_t) * nshards) != 0 ||
+      posix_memalign((void**)&map->queues, LMN_CACHE_LINE_SIZE, sizeof(shard_queue_t) * nshards * nshards) != 0) {
+    fprintf(stderr, "failed to allocate shards\n");
+    exit(1);
+  }
+  for (int i = 0; i < nshards; i++) {
+    local_init(&map->shards[i].table, LOCAL_HASHMAP_DEFAULT_SIZE);
+    map->shards[i].inserted = 0;
+  }
+  for (int i = 0; i < nshards * nshards; i++) {
+    map->queues[i].head = 0;
+    map->queues[i].tail = 0;
+    map->queues[i].ring = lmn_calloc(shard_batch_t, SHARD_QUEUE_BATCHES);
+  }
+}
+
+/* shards own contiguous ranges of the hash space */
+int sharded_owner(sharded_hashmap_t *map, lmn_key_t key) {
+  return (int)((hash<lmn_word>(key) * (lmn_word)map->nshards) >> 32);
+}
+
+/* worker is the caller's shard; only that thread may use it */
+void sharded_put(sharded_hashmap_t *map, int worker, lmn_key_t key, lmn_data_t data) {
+  int owner = sharded_owner(map, key);
+  if (owner == worker) {
+    shard_apply(&map->shards[worker], key, data);
+    return;
+  }
+  shard_queue_t *q = shard_queue(map, worker, owner);
+  shard_batch_t *b = shard_queue_reserve(map, worker, q);
+  b->keys[b->n] = key;
+  b->data[b->n] = data;
+  if (++b->n == SHARD_BATCH) shard_queue_publish(q);
+}
+
+/* applies every batch shipped to worker's shard, returns the number of entries */
+int sharded_poll(sharded_hashmap_t *map, int worker) {
+  shard_t *shard = &map->shards[worker];
+  int applied = 0;
+  for (int src = 0; src < map->nshards; src++) {
+    shard_queue_t *q = shard_queue(map, src, worker);
+    while (q->head != q->tail) {
+      LMN_COMPILER_BARRIER();
+      shard_batch_t *b = &q->ring[q->head & SHARD_QUEUE_MASK];
+      for (int i = 0; i < b->n; i++) {
+        shard_apply(shard, b->keys[i], b->data[i]);
+      }
+      applied += b->n;
+      b->n = 0;
+      LMN_COMPILER_BARRIER();
+      q->head = q->head + 1;
+    }
+  }
+  return applied;
+}
+
+/* ships the partially filled batches of worker */
+void sharded_flush(sharded_hashmap_t *map, int worker) {
+  for (int dst = 0; dst < map->nshards; dst++) {
+    shard_queue_t *q = shard_queue(map, worker, dst);
+    if (dst != worker && q->tail - q->head < SHARD_QUEUE_BATCHES &&
+        q->ring[q->tail & SHARD_QUEUE_MASK].n > 0) {
+      shard_queue_publish(q);
+    }
+  }
+}
+
+/* flushes worker and keeps applying incoming batches until every worker has finished */
+void sharded_finish(sharded_hashmap_t *map, int worker) {
+  sharded_flush(map, worker);
+  LMN_ATOMIC_ADD(&map->finished, 1);
+  while (map->finished < map->nshards) {
+    if (sharded_poll(map, worker) == 0) sched_yield();
+  }
+  sharded_poll(map, worker);
+}
+
+/* reads the owner's table: call it from the owner, or once all workers have finished */
+lmn_data_t sharded_find(sharded_hashmap_t *map, lmn_key_t key) {
+  return local_find(&map->shards[sharded_owner(map, key)].table, key);
+}
+
+lmn_word sharded_count(sharded_hashmap_t *map) {
+  lmn_word count = 0;
+  for (int i = 0; i < map->nshards; i++) {
+    count += map->shards[i].inserted;
+  }
+  return count;
+}
+
+void sharded_free(sharded_hashmap_t *map) {
+  for (int i = 0; i < map->nshards; i++) {
+    local_free(&map->shards[i].table);
+  }
+  for (int i = 0; i < map->nshards * map->nshards; i++) {
+    lmn_free(map->queues[i].ring);
+  }
+  lmn_free(map->shards);
+  lmn_free(map->queues);
+}
+
+}
+}
+}
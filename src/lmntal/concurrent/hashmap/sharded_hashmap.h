@@ -0,0 +1,65 @@
+/**
+ * @file   sharded_hashmap.h
+ * @brief
+ * Partitioned hashmap in the style of distributed-memory model checkers.
+ * Every worker owns the shard of one hash range and keeps it in a plain local table.
+ * Inserts for another shard are buffered per destination and shipped in batches
+ * through single-producer/single-consumer queues; the owner applies them when it polls.
+ * Nothing is shared but the queues, so no CAS touches table memory.
+ * @author Taketo Yoshida
+ */
+#ifndef SHARDED_HASHMAP_H
+#  define SHARDED_HASHMAP_H
+
+#include "local_hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define SHARD_BATCH         256
+#define SHARD_QUEUE_BATCHES 32   // power of two
+
+typedef struct {
+  int        volatile n;
+  lmn_key_t  keys[SHARD_BATCH];
+  lmn_data_t data[SHARD_BATCH];
+} shard_batch_t;
+
+/* the batch at tail is filled in place by the producer and published by advancing tail */
+typedef struct {
+  lmn_word volatile head;
+  char              head_padding[LMN_CACHE_LINE_SIZE - sizeof(lmn_word)];
+  lmn_word volatile tail;
+  char              tail_padding[LMN_CACHE_LINE_SIZE - sizeof(lmn_word)];
+  shard_batch_t    *ring;
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) shard_queue_t;
+
+typedef struct {
+  local_hashmap_t table;
+  lmn_word        inserted; // keys that were new to the shard
+} __attribute__((aligned(LMN_CACHE_LINE_SIZE))) shard_t;
+
+typedef struct {
+  int            nshards;
+  shard_t       *shards;
+  shard_queue_t *queues;    // nshards x nshards, queues[src * nshards + dst]
+  int   volatile finished;  // workers that called sharded_finish
+} sharded_hashmap_t;
+
+void sharded_init(sharded_hashmap_t *map, int nshards);
+int sharded_owner(sharded_hashmap_t *map, lmn_key_t key);
+void sharded_put(sharded_hashmap_t *map, int worker, lmn_key_t key, lmn_data_t data);
+int sharded_poll(sharded_hashmap_t *map, int worker);
+void sharded_flush(sharded_hashmap_t *map, int worker);
+void sharded_finish(sharded_hashmap_t *map, int worker);
+lmn_data_t sharded_find(sharded_hashmap_t *map, lmn_key_t key);
+lmn_word sharded_count(sharded_hashmap_t *map);
+void sharded_free(sharded_hashmap_t *map);
+
+}
+}
+}
+
+#endif /* ifndef SHARDED_HASHMAP_H */
+
@@ -0,0 +1,238 @@
+/**
+ * @file   table_alloc.cc
+ * @brief  
+ * @author Taketo Yoshida
+ */
+#include "table_alloc.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define LMN_THP_ENABLED_PATH "/sys/kernel/mm/transparent_hugepage/enabled"
+
+#define LMN_SMAPS_PATH       "/proc/self/smaps"
+#define LMN_THP_MAX_TABLES   64 // tables tracked for lmn_table_huge_bytes
+
+static int use_huge_pages = FALSE;
+static int volatile weakest_backing = LMN_PAGE_NONE;
+
+/* tables that asked for transparent huge pages, checked against smaps later */
+static void * volatile thp_tables[LMN_THP_MAX_TABLES];
+static size_t volatile thp_lengths[LMN_THP_MAX_TABLES];
+
+/*
+ * private functions
+ */
+
+inline size_t lmn_table_round(size_t bytes) {
+  return (bytes + LMN_HUGE_PAGE_SIZE - 1) & ~(LMN_HUGE_PAGE_SIZE - 1);
+}
+
+/* the weakest backing any table got is what gets reported */
+static void lmn_table_note_backing(lmn_page_backing_t backing) {
+  int cur;
+  while (((cur = weakest_backing) == LMN_PAGE_NONE || backing < cur) &&
+         !LMN_CAS(&weakest_backing, cur, backing));
+}
+
+/* madvise succeeds even if THP is switched off system wide */
+static int lmn_thp_disabled() {
+  char buf[128] = {0};
+  FILE *fp = fopen(LMN_THP_ENABLED_PATH, "r");
+  if (fp == NULL) return TRUE;
+  size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+  fclose(fp);
+  return n == 0 || strstr(buf, "[never]") != NULL;
+}
+
+/* maps len + one huge page and trims it, so the table starts on a 2MB boundary */
+static void *lmn_table_map_aligned(size_t len) {
+  char *raw = (char*)mmap(NULL, len + LMN_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) return NULL;
+  char *aligned = (char*)(((lmn_word)raw + LMN_HUGE_PAGE_SIZE - 1) & ~(LMN_HUGE_PAGE_SIZE - 1));
+  if (aligned != raw) munmap(raw, aligned - raw);
+  munmap(aligned + len, raw + LMN_HUGE_PAGE_SIZE - aligned);
+  return aligned;
+}
+
+static void lmn_thp_track(void *ptr, size_t len) {
+  for (int i = 0; i < LMN_THP_MAX_TABLES; i++) {
+    if (thp_tables[i] == NULL && LMN_CAS(&thp_tables[i], (void*)NULL, ptr)) {
+      thp_lengths[i] = len;
+      return;
+    }
+  }
+}
+
+static void lmn_thp_untrack(void *ptr) {
+  for (int i = 0; i < LMN_THP_MAX_TABLES; i++) {
+    if (thp_tables[i] == ptr) {
+      thp_lengths[i] = 0;
+      thp_tables[i]  = NULL;
+      return;
+    }
+  }
+}
+
+static int lmn_thp_tracked(lmn_word start, lmn_word end) {
+  for (int i = 0; i < LMN_THP_MAX_TABLES; i++) {
+    lmn_word b = (lmn_word)thp_tables[i];
+    if (b != 0 && b < end && start < b + thp_lengths[i]) return TRUE;
+  }
+  return FALSE;
+}
+
+/*
+ * public functions
+ */
+
+void lmn_table_set_huge_pages(int enable) {
+  use_huge_pages  = enable;
+  weakest_backing = LMN_PAGE_NONE;
+}
+
+/* returns zero-filled memory; free it with lmn_table_release and the same size */
+void *lmn_table_alloc(size_t bytes) {
+  if (bytes < LMN_HUGE_PAGE_SIZE) {
+    lmn_table_note_backing(LMN_PAGE_DEFAULT); // too small for a huge page
+    return calloc(1, bytes);
+  }
+
+  size_t len = lmn_table_round(bytes);
+  void *ptr;
+#ifdef MAP_HUGETLB
+  if (use_huge_pages) {
+    ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) {
+      lmn_table_note_backing(LMN_PAGE_HUGETLB);
+      return ptr;
+    }
+  }
+#endif
+  ptr = lmn_table_map_aligned(len);
+  if (ptr == NULL) {
+    fprintf(stderr, "failed to map a table of %lu bytes\n", (lmn_word)bytes);
+    exit(1);
+  }
+  lmn_page_backing_t backing = LMN_PAGE_DEFAULT;
+#ifdef MADV_HUGEPAGE
+  if (use_huge_pages && madvise(ptr, len, MADV_HUGEPAGE) == 0 && !lmn_thp_disabled()) {
+    backing = LMN_PAGE_TRANSPARENT_HUGE;
+    lmn_thp_track(ptr, len);
+  }
+#endif
+  lmn_table_note_backing(backing);
+  return ptr;
+}
+
+void lmn_table_release(void *ptr, size_t bytes) {
+  if (ptr == NULL) return;
+  if (bytes < LMN_HUGE_PAGE_SIZE) {
+    free(ptr);
+  } else {
+    lmn_thp_untrack(ptr);
+    munmap(ptr, lmn_table_round(bytes));
+  }
+}
+
+/*
+ * Bytes of the tables that asked for transparent huge pages which the kernel
+ * actually backs with them (AnonHugePages in smaps), and in *mapped the size
+ * of those tables. madvise only requests huge pages; whether they are obtained
+ * depends on the THP mode, defrag setting and free 2MB pages at fault time, so
+ * this is meaningful once the tables have been written.
+ */
+lmn_word lmn_table_huge_bytes(lmn_word *mapped) {
+  lmn_word huge = 0, total = 0;
+  for (int i = 0; i < LMN_THP_MAX_TABLES; i++) {
+    if (thp_tables[i] != NULL) total += thp_lengths[i];
+  }
+  if (mapped != NULL) *mapped = total;
+  if (total == 0) return 0;
+  FILE *fp = fopen(LMN_SMAPS_PATH, "r");
+  if (fp == NULL) return 0;
+  char line[256];
+  int  counting = FALSE;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    lmn_word start, end, kb;
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+      counting = lmn_thp_tracked(start, end);
+    } else if (counting && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+      huge += kb << 10;
+    }
+  }
+  fclose(fp);
+  return huge;
+}
+
+lmn_page_backing_t lmn_table_backing() {
+  return (lmn_page_backing_t)weakest_backing;
+}
+
+#define LMN_PAGEMAP_PATH    "/proc/self/pagemap"
+#define LMN_PAGEMAP_BATCH   512 // pages looked up at once
+#define LMN_PM_PRESENT      (1ULL << 63)
+#define LMN_PM_SWAPPED      (1ULL << 62)
+#define LMN_PM_EXCLUSIVE    (1ULL << 56)
+
+static int volatile pagemap_fd = -2; // -2 until first opened, -1 when unavailable
+
+static int lmn_pagemap_open() {
+  if (pagemap_fd == -2) {
+    int fd = open(LMN_PAGEMAP_PATH, O_RDONLY);
+    if (!LMN_CAS(&pagemap_fd, -2, fd) && fd >= 0) close(fd);
+  }
+  return pagemap_fd;
+}
+
+/*
+ * Bytes of [ptr, ptr + bytes) on pages the process owns, in memory or swapped out.
+ * Pages that reads of untouched memory mapped to the shared zero page do not count:
+ * they are present but not exclusively mapped. Without /proc/self/pagemap this
+ * falls back to mincore, which counts them. Partially covered pages count with
+ * the covered part only, so disjoint ranges of one array add up.
+ */
+lmn_word lmn_table_committed(const void *ptr, size_t bytes) {
+  static const lmn_word page = (lmn_word)sysconf(_SC_PAGESIZE);
+  if (ptr == NULL || bytes == 0) return 0;
+  int fd = lmn_pagemap_open();
+  lmn_word lo = (lmn_word)ptr, hi = lo + bytes, committed = 0;
+  uint64_t      entries[LMN_PAGEMAP_BATCH];
+  unsigned char vec[LMN_PAGEMAP_BATCH];
+  for (lmn_word base = lo & ~(page - 1); base < hi; base += page * LMN_PAGEMAP_BATCH) {
+    lmn_word n = (hi - base + page - 1) / page;
+    if (n > LMN_PAGEMAP_BATCH) n = LMN_PAGEMAP_BATCH;
+    if (fd >= 0) {
+      if (pread(fd, entries, n * sizeof(uint64_t), (off_t)(base / page * sizeof(uint64_t))) != (ssize_t)(n * sizeof(uint64_t))) return bytes;
+      for (lmn_word i = 0; i < n; i++) {
+        vec[i] = (entries[i] & LMN_PM_SWAPPED) || ((entries[i] & LMN_PM_PRESENT) && (entries[i] & LMN_PM_EXCLUSIVE));
+      }
+    } else if (mincore((void*)base, n * page, vec) != 0) {
+      return bytes; // not a mapping we can ask about
+    }
+    for (lmn_word i = 0; i < n; i++) {
+      if (!(vec[i] & 1)) continue;
+      lmn_word b = base + i * page, e = b + page;
+      committed += ((e < hi) ? e : hi) - ((b > lo) ? b : lo);
+    }
+  }
+  return committed;
+}
+
+const char *lmn_table_backing_name(lmn_page_backing_t backing) {
+  switch (backing) {
+    case LMN_PAGE_HUGETLB:          return "hugetlb 2MB pages";
+    case LMN_PAGE_TRANSPARENT_HUGE: return "transparent huge pages requested";
+    case LMN_PAGE_DEFAULT:          return "4KB pages";
+    default:                        return "none";
+  }
+}
+
+}
+}
+}
@@ -0,0 +1,45 @@
+/**
+ * @file   table_alloc.h
+ * @brief
+ * Allocation of the large, zero-filled table arrays (buckets, data, chain heads, bit arrays).
+ * Arrays of at least LMN_HUGE_PAGE_SIZE bytes are mapped directly and, when huge pages are
+ * enabled, backed by 2MB pages: MAP_HUGETLB from the reserved pool when available, otherwise
+ * transparent huge pages via madvise(MADV_HUGEPAGE), otherwise plain 4KB pages. THP is only a
+ * request; lmn_table_huge_bytes reports how much of those tables the kernel really backs with 2MB pages.
+ * @author Taketo Yoshida
+ */
+#ifndef TABLE_ALLOC_H
+#  define TABLE_ALLOC_H
+
+#include "hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define LMN_HUGE_PAGE_SIZE (2UL << 20)
+
+typedef enum {
+  LMN_PAGE_NONE = -1,          // no table has been mapped yet
+  LMN_PAGE_DEFAULT = 0,
+  LMN_PAGE_TRANSPARENT_HUGE,
+  LMN_PAGE_HUGETLB
+} lmn_page_backing_t;
+
+#define lmn_table_calloc(type, size)       (type*)lmn_table_alloc(sizeof(type) * (size))
+#define lmn_table_free(ptr, type, size)    lmn_table_release((void*)(ptr), sizeof(type) * (size))
+
+void *lmn_table_alloc(size_t bytes);
+void lmn_table_release(void *ptr, size_t bytes);
+void lmn_table_set_huge_pages(int enable);
+lmn_page_backing_t lmn_table_backing();
+const char *lmn_table_backing_name(lmn_page_backing_t backing);
+lmn_word lmn_table_huge_bytes(lmn_word *mapped);
+lmn_word lmn_table_committed(const void *ptr, size_t bytes);
+
+}
+}
+}
+
+#endif /* ifndef TABLE_ALLOC_H */
+
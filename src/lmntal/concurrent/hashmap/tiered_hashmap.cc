@@ -0,0 +1,422 @@
+/**
+ * @file   tiered_hashmap.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "tiered_hashmap.h"
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define TIERED_SCAN_BLOCKS 16 // blocks read at once when streaming a run
+
+typedef struct {
+  lmn_key_t  key;
+  lmn_word   index; // position in the caller's batch
+  lmn_data_t data;
+  int        found;
+} tiered_query_t;
+
+typedef struct {
+  tiered_entry_t *entries;
+  lmn_word        n;
+} tiered_collect_t;
+
+/*
+ * private functions
+ */
+
+inline bool tiered_entry_less(const tiered_entry_t &a, const tiered_entry_t &b) {
+  return a.key < b.key;
+}
+
+inline bool tiered_query_less(const tiered_query_t &a, const tiered_query_t &b) {
+  return a.key < b.key;
+}
+
+inline lmn_word tiered_run_blocks(tiered_run_t *run) {
+  return (run->count + TIERED_BLOCK - 1) / TIERED_BLOCK;
+}
+
+void tiered_io_fail(const char *what) {
+  fprintf(stderr, "tiered hashmap: %s failed: %s\n", what, strerror(errno));
+  exit(1);
+}
+
+void tiered_read(int fd, void *buf, size_t bytes, off_t offset) {
+  char *p = (char*)buf;
+  while (bytes > 0) {
+    ssize_t n = pread(fd, p, bytes, offset);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      tiered_io_fail("pread");
+    }
+    p += n; bytes -= n; offset += n;
+  }
+}
+
+void tiered_write(int fd, const void *buf, size_t bytes) {
+  const char *p = (const char*)buf;
+  while (bytes > 0) {
+    ssize_t n = write(fd, p, bytes);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      tiered_io_fail("write");
+    }
+    p += n; bytes -= n;
+  }
+}
+
+/* reads block b of run into buf, returns the number of entries in it */
+lmn_word tiered_read_block(tiered_hashmap_t *map, tiered_run_t *run, lmn_word b, tiered_entry_t *buf) {
+  lmn_word first = b * TIERED_BLOCK;
+  lmn_word n     = std::min((lmn_word)TIERED_BLOCK, run->count - first);
+  tiered_read(run->fd, buf, n * sizeof(tiered_entry_t), first * sizeof(tiered_entry_t));
+  LMN_ATOMIC_ADD(&map->disk_reads, 1);
+  return n;
+}
+
+/* the block that may hold key, or -1 when key is below the first key of the run */
+inline long tiered_block_of(tiered_run_t *run, lmn_key_t key) {
+  lmn_key_t *fences = run->fences;
+  return (long)(std::upper_bound(fences, fences + tiered_run_blocks(run), key) - fences) - 1;
+}
+
+inline tiered_entry_t *tiered_block_search(tiered_entry_t *block, lmn_word n, lmn_key_t key) {
+  tiered_entry_t probe = { key, NULL };
+  tiered_entry_t *e = std::lower_bound(block, block + n, probe, tiered_entry_less);
+  return (e != block + n && e->key == key) ? e : NULL;
+}
+
+int tiered_run_find(tiered_hashmap_t *map, tiered_run_t *run, lmn_key_t key, lmn_data_t *data) {
+  tiered_entry_t block[TIERED_BLOCK];
+  if (!bitstate_set_contains(&run->bloom, key)) return FALSE;
+  long b = tiered_block_of(run, key);
+  if (b < 0) return FALSE;
+  lmn_word n = tiered_read_block(map, run, b, block);
+  tiered_entry_t *e = tiered_block_search(block, n, key);
+  if (e == NULL) return FALSE;
+  LMN_PTR_VAL(data) = e->data;
+  return TRUE;
+}
+
+/*
+ * Looks up a batch of queries sorted by key in one run. Queries passing the
+ * filter map to non-decreasing blocks, so every block is read at most once.
+ */
+void tiered_run_probe(tiered_hashmap_t *map, tiered_run_t *run, tiered_query_t *queries, lmn_word n) {
+  tiered_entry_t block[TIERED_BLOCK];
+  long     cached = -1;
+  lmn_word size   = 0;
+  for (lmn_word i = 0; i < n; i++) {
+    tiered_query_t *q = &queries[i];
+    if (q->found || !bitstate_set_contains(&run->bloom, q->key)) continue;
+    long b = tiered_block_of(run, q->key);
+    if (b < 0) continue;
+    if (b != cached) {
+      size   = tiered_read_block(map, run, b, block);
+      cached = b;
+    }
+    tiered_entry_t *e = tiered_block_search(block, size, q->key);
+    if (e != NULL) {
+      q->data  = e->data;
+      q->found = TRUE;
+    }
+  }
+}
+
+/* writes n sorted entries to a new run file; the run is not visible until a version holds it */
+tiered_run_t *tiered_run_create(tiered_hashmap_t *map, tiered_entry_t *entries, lmn_word n) {
+  size_t len  = strlen(map->dir) + sizeof("/lmn-tier-XXXXXX");
+  char  *path = (char*)malloc(len);
+  snprintf(path, len, "%s/lmn-tier-XXXXXX", map->dir);
+  int fd = mkstemp(path);
+  if (fd < 0) tiered_io_fail(path);
+  unlink(path);
+  free(path);
+  tiered_write(fd, entries, n * sizeof(tiered_entry_t));
+
+  tiered_run_t *run = lmn_malloc(tiered_run_t);
+  run->fd     = fd;
+  run->count  = n;
+  run->fences = lmn_calloc(lmn_key_t, tiered_run_blocks(run));
+  for (lmn_word b = 0; b < tiered_run_blocks(run); b++) {
+    run->fences[b] = entries[b * TIERED_BLOCK].key;
+  }
+  bitstate_init_with_size(&run->bloom, n * TIERED_BLOOM_BITS, TIERED_BLOOM_HASH);
+  for (lmn_word i = 0; i < n; i++) {
+    bitstate_set_insert(&run->bloom, entries[i].key);
+  }
+  return run;
+}
+
+void tiered_run_free(tiered_run_t *run) {
+  close(run->fd);
+  lmn_free(run->fences);
+  bitstate_free(&run->bloom);
+  lmn_free(run);
+}
+
+/* a new version of the run list: the runs of prev followed by run (if any) */
+tiered_runs_t *tiered_runs_new(tiered_runs_t *prev, tiered_run_t *run) {
+  int nruns = (prev ? prev->nruns : 0) + (run ? 1 : 0);
+  tiered_runs_t *v = (tiered_runs_t*)malloc(sizeof(tiered_runs_t) + sizeof(tiered_run_t*) * nruns);
+  v->prev  = prev;
+  v->nruns = 0;
+  for (int r = 0; prev && r < prev->nruns; r++) {
+    v->runs[v->nruns++] = prev->runs[r];
+  }
+  if (run) v->runs[v->nruns++] = run;
+  return v;
+}
+
+void tiered_collect_iter(lmn_key_t key, lmn_data_t data, void *arg) {
+  tiered_collect_t *c = (tiered_collect_t*)arg;
+  c->entries[c->n].key  = key;
+  c->entries[c->n].data = data;
+  c->n++;
+}
+
+inline void tiered_collect(local_hashmap_t *buf, tiered_collect_t *c) {
+  if (buf != NULL) local_scan(buf, 0, local_slots(buf), tiered_collect_iter, c);
+}
+
+/* drops the entries (sorted by key) that some run of v already holds, returns how many are left */
+lmn_word tiered_drop_on_disk(tiered_hashmap_t *map, tiered_runs_t *v, tiered_entry_t *entries, lmn_word n) {
+  if (v->nruns == 0 || n == 0) return n;
+  tiered_query_t *queries = lmn_calloc(tiered_query_t, n);
+  for (lmn_word i = 0; i < n; i++) {
+    queries[i].key = entries[i].key;
+  }
+  for (int r = 0; r < v->nruns; r++) {
+    tiered_run_probe(map, v->runs[r], queries, n);
+  }
+  lmn_word kept = 0;
+  for (lmn_word i = 0; i < n; i++) {
+    if (!queries[i].found) entries[kept++] = entries[i];
+  }
+  lmn_free(queries);
+  return kept;
+}
+
+/*
+ * Swaps in an empty spill buffer, then sorts the full one, drops the keys some run
+ * already holds and writes the rest as a new run without the lock. Lookups keep
+ * seeing the buffer as map->flushing until the version holding its run is published.
+ */
+void tiered_flush_spill(tiered_hashmap_t *map, lmn_word min_count) {
+  pthread_mutex_lock(&map->flush_lock);
+  pthread_mutex_lock(&map->lock);
+  if (map->spill.count == 0 || map->spill.count < min_count) {
+    pthread_mutex_unlock(&map->lock);
+    pthread_mutex_unlock(&map->flush_lock);
+    return;
+  }
+  local_hashmap_t *buf = lmn_malloc(local_hashmap_t);
+  *buf = map->spill;
+  local_init(&map->spill, LOCAL_HASHMAP_DEFAULT_SIZE);
+  map->flushing = buf;
+  tiered_runs_t *v = map->runs; // only flushes replace it, and they are serialized
+  pthread_mutex_unlock(&map->lock);
+
+  tiered_collect_t c = { lmn_calloc(tiered_entry_t, buf->count), 0 };
+  tiered_collect(buf, &c);
+  std::sort(c.entries, c.entries + c.n, tiered_entry_less);
+  lmn_word n = tiered_drop_on_disk(map, v, c.entries, c.n);
+  tiered_runs_t *next = (n > 0) ? tiered_runs_new(v, tiered_run_create(map, c.entries, n)) : v;
+
+  pthread_mutex_lock(&map->lock);
+  map->runs        = next;
+  map->disk_count += n;
+  map->flushing    = NULL;
+  pthread_mutex_unlock(&map->lock);
+  local_free(buf);
+  lmn_free(buf);
+  lmn_free(c.entries);
+  pthread_mutex_unlock(&map->flush_lock);
+}
+
+/*
+ * The buffered value of key, called under the lock. The flushing buffer is older
+ * than the spill buffer, and puts keep the two disjoint.
+ */
+inline lmn_data_t tiered_buffered_find(tiered_hashmap_t *map, lmn_key_t key) {
+  if (map->flushing != NULL && local_contains(map->flushing, key)) return local_find(map->flushing, key);
+  return local_find(&map->spill, key);
+}
+
+/*
+ * public functions
+ */
+
+void tiered_init(tiered_hashmap_t *map) {
+  const char *dir = getenv("TMPDIR");
+  tiered_init_with_size(map, LMN_DEFAULT_SIZE, dir ? dir : TIERED_DEFAULT_DIR);
+}
+
+/* mem_slots must be a power of two; run files are created (and immediately unlinked) in dir */
+void tiered_init_with_size(tiered_hashmap_t *map, lmn_word mem_slots, const char *dir) {
+  lmn_hashmap_init_with_size(&map->mem, mem_slots);
+  pthread_mutex_init(&map->lock, NULL);
+  pthread_mutex_init(&map->flush_lock, NULL);
+  local_init(&map->spill, LOCAL_HASHMAP_DEFAULT_SIZE);
+  map->flushing   = NULL;
+  map->runs       = tiered_runs_new(NULL, NULL);
+  map->disk_count = 0;
+  map->disk_reads = 0;
+  map->dir        = strdup(dir);
+}
+
+/*
+ * The runs come first: a buffer may hold a later duplicate of a key on disk. The
+ * buffers and the run list are read in the same critical section, so a flush
+ * running meanwhile can not move the key out of sight.
+ */
+lmn_data_t tiered_find(tiered_hashmap_t *map, lmn_key_t key) {
+  lmn_data_t data;
+  switch (lmn_hashmap_try_find(&map->mem, key, &data)) {
+    case CC_TRY_FOUND:  return data;
+    case CC_TRY_ABSENT: return LMN_HASH_EMPTY_DATA;
+  }
+  // the memory tier is full along this key's probe sequence, so it lives below
+  pthread_mutex_lock(&map->lock);
+  tiered_runs_t *v        = map->runs;
+  lmn_data_t     buffered = tiered_buffered_find(map, key);
+  pthread_mutex_unlock(&map->lock);
+  for (int r = v->nruns - 1; r >= 0; r--) {
+    if (tiered_run_find(map, v->runs[r], key, &data)) return data;
+  }
+  return buffered;
+}
+
+/* as in the CC map the first put of a key wins; duplicates against the runs are dropped at flush */
+void tiered_put(tiered_hashmap_t *map, lmn_key_t key, lmn_data_t data) {
+  if (lmn_hashmap_try_put(&map->mem, key, data) != CC_TRY_FULL) return;
+  int full = FALSE;
+  pthread_mutex_lock(&map->lock);
+  if (!local_contains(&map->spill, key) && (map->flushing == NULL || !local_contains(map->flushing, key))) {
+    local_put(&map->spill, key, data);
+    full = map->spill.count >= TIERED_RUN_ENTRIES;
+  }
+  pthread_mutex_unlock(&map->lock);
+  if (full) tiered_flush_spill(map, TIERED_RUN_ENTRIES);
+}
+
+/* memory misses of the whole batch are sorted and probed run by run, one read per block */
+void tiered_find_batch(tiered_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n) {
+  tiered_query_t *queries = NULL;
+  lmn_word nqueries = 0;
+  for (int i = 0; i < n; i++) {
+    lmn_data_t data = LMN_HASH_EMPTY_DATA;
+    if (lmn_hashmap_try_find(&map->mem, keys[i], &data) == CC_TRY_FULL) {
+      if (queries == NULL) queries = lmn_calloc(tiered_query_t, n);
+      queries[nqueries].key   = keys[i];
+      queries[nqueries].index = i;
+      nqueries++;
+    }
+    out[i] = data;
+  }
+  if (nqueries == 0) return;
+
+  std::sort(queries, queries + nqueries, tiered_query_less);
+  pthread_mutex_lock(&map->lock);
+  tiered_runs_t *v = map->runs;
+  for (lmn_word i = 0; i < nqueries; i++) {
+    out[queries[i].index] = tiered_buffered_find(map, queries[i].key);
+  }
+  pthread_mutex_unlock(&map->lock);
+  for (int r = v->nruns - 1; r >= 0; r--) {
+    tiered_run_probe(map, v->runs[r], queries, nqueries);
+  }
+  for (lmn_word i = 0; i < nqueries; i++) {
+    if (queries[i].found) out[queries[i].index] = queries[i].data;
+  }
+  lmn_free(queries);
+}
+
+/* writes the spill buffer out as a run */
+void tiered_flush(tiered_hashmap_t *map) {
+  tiered_flush_spill(map, 0);
+}
+
+void tiered_free(tiered_hashmap_t *map) {
+  lmn_hashmap_free(&map->mem);
+  local_free(&map->spill);
+  for (int r = 0; r < map->runs->nruns; r++) {
+    tiered_run_free(map->runs->runs[r]);
+  }
+  for (tiered_runs_t *v = map->runs, *prev; v != NULL; v = prev) {
+    prev = v->prev;
+    free(v);
+  }
+  free(map->dir);
+  pthread_mutex_destroy(&map->lock);
+  pthread_mutex_destroy(&map->flush_lock);
+}
+
+/* the slots of the memory tier, plus one last slot standing for everything below it */
+lmn_word tiered_slots(tiered_hashmap_t *map) {
+  return lmn_hashmap_slots(&map->mem) + 1;
+}
+
+/*
+ * The overflow slot reports the buffered entries no run holds, then every run.
+ * Memory keys never overflow and runs never share a key, so each key of the
+ * snapshot is reported once; fn is called without the map lock.
+ */
+void tiered_scan(tiered_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg) {
+  lmn_word mem_slots = lmn_hashmap_slots(&map->mem);
+  if (begin < mem_slots) {
+    lmn_hashmap_scan(&map->mem, begin, std::min(end, mem_slots), fn, arg);
+  }
+  if (end <= mem_slots) return;
+
+  pthread_mutex_lock(&map->lock);
+  tiered_runs_t   *v = map->runs;
+  tiered_collect_t c = { lmn_calloc(tiered_entry_t, map->spill.count + (map->flushing ? map->flushing->count : 0) + 1), 0 };
+  tiered_collect(map->flushing, &c);
+  tiered_collect(&map->spill, &c);
+  pthread_mutex_unlock(&map->lock);
+  std::sort(c.entries, c.entries + c.n, tiered_entry_less);
+  lmn_word n = tiered_drop_on_disk(map, v, c.entries, c.n);
+  for (lmn_word i = 0; i < n; i++) {
+    fn(c.entries[i].key, c.entries[i].data, arg);
+  }
+  lmn_free(c.entries);
+
+  tiered_entry_t *buf = lmn_calloc(tiered_entry_t, TIERED_BLOCK * TIERED_SCAN_BLOCKS);
+  for (int r = 0; r < v->nruns; r++) {
+    tiered_run_t *run = v->runs[r];
+    for (lmn_word i = 0; i < run->count; ) {
+      lmn_word n = std::min((lmn_word)(TIERED_BLOCK * TIERED_SCAN_BLOCKS), run->count - i);
+      tiered_read(run->fd, buf, n * sizeof(tiered_entry_t), i * sizeof(tiered_entry_t));
+      for (lmn_word j = 0; j < n; j++) {
+        fn(buf[j].key, buf[j].data, arg);
+      }
+      i += n;
+    }
+  }
+  lmn_free(buf);
+}
+
+lmn_word tiered_overflow_count(tiered_hashmap_t *map) {
+  pthread_mutex_lock(&map->lock);
+  lmn_word count = map->spill.count + (map->flushing ? map->flushing->count : 0) + map->disk_count;
+  pthread_mutex_unlock(&map->lock);
+  return count;
+}
+
+int tiered_run_count(tiered_hashmap_t *map) {
+  pthread_mutex_lock(&map->lock);
+  int nruns = map->runs->nruns;
+  pthread_mutex_unlock(&map->lock);
+  return nruns;
+}
+
+}
+}
+}
@@ -0,0 +1,82 @@
+/**
+ * @file   tiered_hashmap.h
+ * @brief
+ * Out-of-core hashmap: a CC table in memory, overflowing into sorted run files on disk.
+ * A key whose probe sequence in the memory tier is full goes to a spill buffer; full
+ * buffers are sorted, checked against the existing runs in one batched pass (delayed
+ * duplicate detection) and written out as a new run, so runs never share a key.
+ * Every run keeps a Bloom filter and the first key of each disk block in memory,
+ * so a miss costs no I/O in most cases and one block read otherwise.
+ * Runs are immutable and every flush publishes a new version of the run list, so
+ * lookups take the lock only to snapshot the list and the buffers and do their
+ * block reads without it; a flush likewise sorts and writes outside the lock.
+ * Delayed duplicate detection : R. E. Korf, "Best-First Frontier Search with Delayed Duplicate Detection", AAAI 2004
+ * @author Taketo Yoshida
+ */
+#ifndef TIERED_HASHMAP_H
+#  define TIERED_HASHMAP_H
+
+#include "cc_hashmap.h"
+#include "local_hashmap.h"
+#include "bitstate_hashmap.h"
+
+namespace lmntal {
+namespace concurrent {
+namespace hashmap {
+
+#define TIERED_BLOCK           256       // entries per disk block (4KB)
+#define TIERED_RUN_ENTRIES     (1 << 20) // spill buffer size that triggers a new run
+#define TIERED_BLOOM_BITS      10        // bits per entry of the run filters
+#define TIERED_BLOOM_HASH      7
+#define TIERED_DEFAULT_DIR     "/tmp"
+
+typedef struct {
+  lmn_key_t  key;
+  lmn_data_t data;
+} tiered_entry_t;
+
+typedef struct {
+  int                 fd;      // unlinked on creation, the file goes away with it
+  lmn_word            count;
+  lmn_key_t          *fences;  // first key of every block
+  bitstate_hashmap_t  bloom;
+} tiered_run_t;
+
+typedef struct _tiered_runs_t {
+  struct _tiered_runs_t *prev;    // the version this one replaced, kept until the map is freed
+  int                    nruns;
+  tiered_run_t          *runs[1]; // oldest first
+} tiered_runs_t;
+
+typedef struct {
+  lmn_hashmap_t     mem;
+  pthread_mutex_t   lock;       // guards the buffers, the run list and disk_count, never held across I/O
+  pthread_mutex_t   flush_lock; // one flush at a time
+  local_hashmap_t   spill;
+  local_hashmap_t  *flushing;   // the buffer being written out as a run, NULL when idle
+  tiered_runs_t    *runs;       // current version of the run list
+  lmn_word          disk_count;
+  lmn_word volatile disk_reads;
+  char             *dir;
+} tiered_hashmap_t;
+
+void tiered_init(tiered_hashmap_t *map);
+void tiered_init_with_size(tiered_hashmap_t *map, lmn_word mem_slots, const char *dir);
+lmn_data_t tiered_find(tiered_hashmap_t *map, lmn_key_t key);
+void tiered_put(tiered_hashmap_t *map, lmn_key_t key, lmn_data_t data);
+void tiered_find_batch(tiered_hashmap_t *map, const lmn_key_t *keys, lmn_data_t *out, int n);
+void tiered_flush(tiered_hashmap_t *map);
+void tiered_free(tiered_hashmap_t *map);
+lmn_word tiered_slots(tiered_hashmap_t *map);
+void tiered_scan(tiered_hashmap_t *map, lmn_word begin, lmn_word end, hashmap_iter_t fn, void *arg);
+
+/* entries beyond the memory tier: the spill buffers plus every run */
+lmn_word tiered_overflow_count(tiered_hashmap_t *map);
+int tiered_run_count(tiered_hashmap_t *map);
+
+}
+}
+}
+
+#endif /* ifndef TIERED_HASHMAP_H */
+
@@ -5,15 +5,47 @@
  */
 #include "thread.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 
 namespace lmntal {
 namespace concurrent {
 
 int _thread_count = -1;
-__thread int _thread_id = 0;
+__thread int _thread_id = -1;
+
+/*
+ * Every thread that touches a map owns a distinct id: per-thread structures
+ * (counters, combining slots, front caches, trace streams, MCS nodes) are
+ * indexed by it without further synchronization. Ids are recycled when a
+ * thread exits, so per-thread arrays stay bounded by LMN_MAX_THREADS.
+ */
+static volatile int _thread_slots[LMN_MAX_THREADS];
+static pthread_key_t _thread_key;
+
+static int AcquireThreadId();
+static void ReleaseThreadId(int id);
+
+/* threads not started through Thread (including the main thread) get their id on first use */
+static void ThreadExit(void *id) {
+  ReleaseThreadId((int)(long)id - 1);
+}
+
+static int RegisterThread() {
+  _thread_id = AcquireThreadId();
+  pthread_setspecific(_thread_key, (void*)(long)(_thread_id + 1));
+  return _thread_id;
+}
+
+/* the main thread is registered before main() runs, so it always has id 0 */
+static int InitThreadIds() {
+  pthread_key_create(&_thread_key, ThreadExit);
+  return RegisterThread();
+}
+static int _main_thread_id __attribute__((unused)) = InitThreadIds();
 
 int GetCurrentThreadId() {
+  if (__builtin_expect(_thread_id < 0, 0)) return RegisterThread();
   return _thread_id;
 }
 
@@ -21,9 +53,25 @@ int GetCurrentThreadCount() {
   return _thread_count + 1;
 }
 
+static int AcquireThreadId() {
+  for (int i = 0; i < LMN_MAX_THREADS; i++) {
+    if (_thread_slots[i] == 0 && __sync_bool_compare_and_swap(&_thread_slots[i], 0, 1)) {
+      int count;
+      while ((count = _thread_count) < i && !__sync_bool_compare_and_swap(&_thread_count, count, i));
+      return i;
+    }
+  }
+  fprintf(stderr, "too many threads (max %d)\n", LMN_MAX_THREADS);
+  exit(1);
+}
+
+static void ReleaseThreadId(int id) {
+  __sync_lock_release(&_thread_slots[id]);
+}
+
+/* the id is released by the key destructor when the thread exits */
 void* __Run(void *cthis) {
-  __sync_fetch_and_add(&_thread_count, 1);
-  _thread_id = _thread_count;
+  RegisterThread();
   static_cast<Runnable*>(cthis)->Run();
   return NULL;
 }
@@ -40,5 +88,38 @@ int Thread::Join() {
   return pthread_join(threadID, NULL);
 }
 
+class ParallelWorker : public Thread {
+public:
+  ParallelFunc func;
+  void *arg;
+  int index;
+  int nthreads;
+
+  ParallelWorker() : Runnable(), func(NULL), arg(NULL), index(0), nthreads(0) {}
+
+  void Run() {
+    func(index, nthreads, arg);
+  }
+};
+
+void RunParallel(int nthreads, ParallelFunc func, void *arg) {
+  if (nthreads <= 1) {
+    func(0, 1, arg);
+    return;
+  }
+  ParallelWorker *workers = new ParallelWorker[nthreads];
+  for (int i = 0; i < nthreads; i++) {
+    workers[i].func     = func;
+    workers[i].arg      = arg;
+    workers[i].index    = i;
+    workers[i].nthreads = nthreads;
+    workers[i].Start();
+  }
+  for (int i = 0; i < nthreads; i++) {
+    workers[i].Join();
+  }
+  delete [] workers;
+}
+
 }
 }
@@ -15,9 +15,16 @@ extern __thread int _thread_id;
 namespace lmntal {
 namespace concurrent {
 
+#define LMN_MAX_THREADS 128
+
+typedef void (*ParallelFunc)(int index, int nthreads, void *arg);
+
 int GetCurrentThreadId();
 int GetCurrentThreadCount();
 
+/* runs func(i, nthreads, arg) for i in [0, nthreads) on fresh threads and joins them */
+void RunParallel(int nthreads, ParallelFunc func, void *arg);
+
 class Runnable {
 private:
 protected:
@@ -16,9 +16,22 @@
 #include "lmntal/concurrent/hashmap/chain_hashmap.h"
 #include "lmntal/concurrent/hashmap/lf_chain_hashmap.h"
 #include "lmntal/concurrent/hashmap/cc_hashmap.h"
+#include "lmntal/concurrent/hashmap/bitstate_hashmap.h"
+#include "lmntal/concurrent/hashmap/cuckoo_hashmap.h"
+#include "lmntal/concurrent/hashmap/cc_compact_hashmap.h"
+#include "lmntal/concurrent/hashmap/fc_chain_hashmap.h"
+#include "lmntal/concurrent/hashmap/sharded_hashmap.h"
+#include "lmntal/concurrent/hashmap/tiered_hashmap.h"
+#include "lmntal/concurrent/hashmap/frozen_hashmap.h"
+#include "lmntal/concurrent/hashmap/hashmap_trace.h"
+#include "lmntal/concurrent/hashmap/table_alloc.h"
+#include "lmntal/concurrent/hashmap/hashmap_front.h"
+#include "lmntal/concurrent/hashmap/hashmap_stats.h"
 #include "lmntal/concurrent/thread.h"
+#include "perf_counter.h"
 #include <iostream>
 #include <time.h>
+#include <math.h>
 
 #define uint64_t long long
 
@@ -166,12 +179,28 @@ double genrand_res53(void)
 #define ALG_NAME_LOCK_CHAINED_HASHMAP "lch"
 #define ALG_NAME_LOCK_FREE_CHAINED_HASHMAP "lfch"
 #define ALG_NAME_CC_HASHMAP "cch"
+#define ALG_NAME_BITSTATE "bs"
+#define ALG_NAME_CUCKOO_HASHMAP "ckh"
+#define ALG_NAME_CC_COMPACT_HASHMAP "cch32"
+#define ALG_NAME_COMBINING_CHAINED_HASHMAP "fch"
+#define ALG_NAME_SHARDED_HASHMAP "shard"
+#define ALG_NAME_TIERED_HASHMAP "tier"
+
+#define DEFAULT_BITS_PER_STATE 8
+#define DEFAULT_EXPECTED_STATES (1 << 24)
+#define DEFAULT_MEM_SLOTS_LOG2 20
 
 static int num_threads_;
+static unsigned long key_mask_ = 0xffffffffUL;
 static volatile int start_, stop_, load_;
 static double load_time_;
 static int duration_;
 static int enter_;
+static int insert_only_;
+static int perf_;
+static int dup_;  // find_or_put workload where half the keys repeat recent ones
+static int lock_policy_ = LMN_LOCK_MUTEX; // segment locks of the lock based chain map
+static unsigned long seed_; // 0: seeded from the clock
 static pthread_mutex_t mutex[100];
 
 class HashMapTest : public Thread {
@@ -180,21 +209,32 @@ private:
   int id;
 public:
   hashmap_t* map;
+  hashset_t* set;
   double cpu_time;
   int ops;
+  perf_counter_t perf;
+  perf_counter_values_t perf_values;
   
-  HashMapTest() : ops(0), cpu_time(0), id(HashMapTest::count++), Runnable() {}
+  HashMapTest() : Runnable(), id(HashMapTest::count++), map(NULL), set(NULL), cpu_time(0), ops(0) {
+    memset(&perf_values, 0x00, sizeof(perf_values));
+  }
 
   void initialize(hashmap_t *hashmap) {
     map = hashmap;
   }
 
+  void initialize(hashset_t *hashset) {
+    set = hashset;
+  }
+
   void Run() {
     int section = (COUNT / HashMapTest::count);
     int offset  = section * id + 1; 
-    init_genrand((unsigned)time(NULL) / offset);
+    init_genrand(seed_ ? seed_ + id : (unsigned)time(NULL) / offset);
     LMN_DBG("Enter thread id:%d\n", id);
+    if (perf_) perf_counter_open(&perf);
     pthread_mutex_lock(&mutex[id]);
+    if (perf_) perf_counter_start(&perf);
     //for (int i = offset; i < offset + section; i++) {
     //  //LMN_ASSERT(!(hashmap_find(map, i) == (lmn_data_t)i));
     //  if (!(hashmap_find(map, i) == (lmn_data_t)i)) {
@@ -202,26 +242,293 @@ public:
     //}
     int insert_count = 0;
     unsigned long rand_val = genrand_int32();
+    lmn_key_t recent[256] = {0};
     while(stop_ == 0) {
       this->ops++;
-      rand_val = genrand_int32() + 1;
+      rand_val = (genrand_int32() & key_mask_) + 1;
       //rand_val = this->ops;
       //rand_val = this->ops;
       insert_count++;
+      if (set) {
+        hashset_insert(set, rand_val);
+        if (!hashset_contains(set, rand_val)) {
+          LMN_DBG("%s[worker thread] insert fail [expected:%lu] thread:%d%s\n",LMN_TERMINAL_RED, rand_val, GetCurrentThreadId(),LMN_TERMINAL_DEFAULT);
+          LMN_ASSERT(FALSE);
+        }
+        continue;
+      }
+      if (dup_) {
+        // successors are often states the same thread has just produced
+        lmn_key_t key = (rand_val & 1) && recent[rand_val >> 1 & 255] ? recent[rand_val >> 1 & 255] : rand_val;
+        lmn_data_t val = hashmap_find_or_put(map, key, (lmn_data_t)key);
+        if (val != LMN_HASH_EMPTY_DATA && val != (lmn_data_t)key) {
+          LMN_DBG("%s[worker thread] find_or_put fail [expected:%lu] [real:%p] thread:%d%s\n",LMN_TERMINAL_RED, key, val, GetCurrentThreadId(),LMN_TERMINAL_DEFAULT);
+        }
+        recent[this->ops & 255] = key;
+        continue;
+      }
       hashmap_put(map, rand_val, (lmn_data_t)rand_val);
+      if (insert_only_) continue;
       lmn_data_t val = hashmap_find(map, rand_val);
       if (val != (lmn_data_t)rand_val) {
         LMN_DBG("%s[worker thread] insert fail [expected:%u] [real:%u] thread:%d%s\n",LMN_TERMINAL_RED, rand_val, val, GetCurrentThreadId(),LMN_TERMINAL_DEFAULT);
         LMN_ASSERT(val == (lmn_data_t)rand_val);
       }
     }
+    if (perf_) {
+      perf_counter_stop(&perf, &perf_values);
+      perf_counter_close(&perf);
+    }
     LMN_DBG("End id: %d, insert_count:%d, ops:%d\n", id, insert_count, ops);
   }
 };
 
 int HashMapTest::count = 0;
 
+/* insert-only worker of the sharded map: thread i owns shard i */
+class ShardTest : public Thread {
+private:
+  static int count;
+  int id;
+public:
+  sharded_hashmap_t* map;
+  int ops;
+  perf_counter_t perf;
+  perf_counter_values_t perf_values;
+
+  ShardTest() : Runnable(), id(ShardTest::count++), map(NULL), ops(0) {
+    memset(&perf_values, 0x00, sizeof(perf_values));
+  }
+
+  void initialize(sharded_hashmap_t *sharded) {
+    map = sharded;
+  }
+
+  void Run() {
+    init_genrand(seed_ ? seed_ + id : (unsigned)time(NULL) / (id + 1));
+    if (perf_) perf_counter_open(&perf);
+    pthread_mutex_lock(&mutex[id]);
+    if (perf_) perf_counter_start(&perf);
+    while(stop_ == 0) {
+      this->ops++;
+      unsigned long rand_val = (genrand_int32() & key_mask_) + 1;
+      sharded_put(map, id, rand_val, (lmn_data_t)rand_val);
+      if ((this->ops & 63) == 0) sharded_poll(map, id);
+    }
+    if (perf_) {
+      perf_counter_stop(&perf, &perf_values);
+      perf_counter_close(&perf);
+    }
+    sharded_finish(map, id);
+  }
+};
+
+int ShardTest::count = 0;
+
+/* plays one recorded stream back as fast as possible */
+class ReplayTest : public Thread {
+private:
+  static int count;
+  int id;
+public:
+  hashmap_t* map;
+  const hashmap_trace_record_t *records;
+  uint64_t nrecords;
+
+  ReplayTest() : Runnable(), id(ReplayTest::count++), map(NULL), records(NULL), nrecords(0) {}
+
+  void initialize(hashmap_t *hashmap, hashmap_trace_file_t *file) {
+    map = hashmap;
+    nrecords = hashmap_trace_stream(file, id, &records);
+  }
+
+  void Run() {
+    pthread_mutex_lock(&mutex[id]);
+    for (uint64_t i = 0; i < nrecords; i++) {
+      const hashmap_trace_record_t *r = &records[i];
+      if (r->op == HASHMAP_TRACE_PUT)
+        hashmap_put(map, r->key, (lmn_data_t)r->data);
+      else
+        hashmap_find(map, r->key);
+    }
+  }
+};
+
+int ReplayTest::count = 0;
+
+/* every stream gets its own thread; the file is mapped and populated before the clock starts */
+static void run_replay(hashmap_t *map, hashmap_trace_file_t *file) {
+  int nthreads = (int)file->nstreams;
+  if (nthreads > (int)(sizeof(mutex) / sizeof(mutex[0]))) {
+    fprintf(stderr, "too many streams in the trace: %d\n", nthreads);
+    exit(-1);
+  }
+  ReplayTest *threads = new ReplayTest[nthreads];
+  uint64_t ops = 0;
+  for (int i = 0; i < nthreads; i++) {
+    threads[i].initialize(map, file);
+    ops += threads[i].nrecords;
+    pthread_mutex_init(&mutex[i], NULL);
+    pthread_mutex_lock(&mutex[i]);
+  }
+  for (int i = 0; i < nthreads; i++) {
+    threads[i].Start();
+  }
+  sleep(1);
+  double start = gettimeofday_sec();
+  for (int i = 0; i < nthreads; i++) {
+    pthread_mutex_unlock(&mutex[i]);
+  }
+  for (int i = 0; i < nthreads; i++) {
+    threads[i].Join();
+  }
+  double end = gettimeofday_sec();
+  printf("replay: %d streams, %lu ops, %lf s, %.3lf Mops/s\n", nthreads, (unsigned long)ops, end - start, (double)ops / (end - start) / 1000000.0);
+  delete [] threads;
+}
+
 #define U_SEC 1000000
+#define LOOKUPS (1 << 22)
+#define MAX_BATCH 1024
+
+typedef struct {
+  hashmap_t  *map;
+  lmn_key_t  *keys;  // random existing keys are drawn from here
+  lmn_word    nkeys;
+  int         batch; // keys per hashmap_find_batch, 0 for single finds
+} lookup_bench_t;
+
+static void lookup_worker(int index, int nthreads, void *arg) {
+  lookup_bench_t *b = (lookup_bench_t*)arg;
+  lmn_key_t  keys[MAX_BATCH];
+  lmn_data_t out[MAX_BATCH];
+  int        group = b->batch ? b->batch : 1;
+  unsigned long x = 88172645463325252UL ^ (index + 1);
+  for (int i = 0; i < LOOKUPS; i += group) {
+    for (int j = 0; j < group; j++) {
+      x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+      keys[j] = b->keys[x % b->nkeys];
+    }
+    if (b->batch) {
+      hashmap_find_batch(b->map, keys, out, group);
+    } else {
+      out[0] = hashmap_find(b->map, keys[0]);
+    }
+    for (int j = 0; j < group; j++) {
+      if (out[j] != (lmn_data_t)keys[j]) {
+        LMN_DBG("%s[lookup] wrong value for key:%lu%s\n", LMN_TERMINAL_RED, keys[j], LMN_TERMINAL_DEFAULT);
+      }
+    }
+  }
+}
+
+/* madvise only requests THP; report what the touched tables really got */
+static void print_huge_backing() {
+  if (lmn_table_backing() != LMN_PAGE_TRANSPARENT_HUGE) return;
+  lmn_word mapped, huge = lmn_table_huge_bytes(&mapped);
+  printf("table backing: %.1f of %.1f MB on transparent huge pages\n", huge / 1048576.0, mapped / 1048576.0);
+}
+
+/* read-only find throughput in Mops/s */
+static double lookup_rate(hashmap_t *map, lmn_key_t *keys, lmn_word nkeys, int batch, int nthreads) {
+  lookup_bench_t b = { map, keys, nkeys, batch };
+  double start = gettimeofday_sec();
+  RunParallel(nthreads, lookup_worker, &b);
+  return (double)LOOKUPS * nthreads / (gettimeofday_sec() - start) / 1000000.0;
+}
+
+static void init_map(hashmap_t *map, hashmap_type_t type, int mem_slots_log2, const char *tier_dir) {
+  if (type == LMN_MC_CLIFF_CLICK_TIERED) {
+    hashmap_tiered_init(map, (lmn_word)1 << (mem_slots_log2 ? mem_slots_log2 : DEFAULT_MEM_SLOTS_LOG2), tier_dir);
+  } else if (type == LMN_MC_CLIFF_CLICK && mem_slots_log2) {
+    hashmap_cc_init_with_size(map, (lmn_word)1 << mem_slots_log2);
+  } else if (type == LMN_CLOSED_ADDRESSING) {
+    hashmap_chain_init_with_lock(map, lock_policy_);
+  } else {
+    hashmap_init(map, type);
+  }
+}
+
+typedef struct {
+  hashmap_t  *map;
+  lmn_key_t  *keys;
+  lmn_data_t *values;
+  lmn_word    n;
+} put_bench_t;
+
+static void put_worker(int index, int nthreads, void *arg) {
+  put_bench_t *b = (put_bench_t*)arg;
+  for (lmn_word i = b->n * index / nthreads; i < b->n * (index + 1) / nthreads; i++) {
+    hashmap_put(b->map, b->keys[i], b->values[i]);
+  }
+}
+
+/* loads the same random pairs into a fresh map with hashmap_bulk_load and with parallel puts */
+static void run_bulk_load(hashmap_type_t type, int mem_slots_log2, const char *tier_dir, lmn_word n, int nthreads) {
+  lmn_key_t  *keys   = (lmn_key_t*)malloc(sizeof(lmn_key_t) * n);
+  lmn_data_t *values = (lmn_data_t*)malloc(sizeof(lmn_data_t) * n);
+  init_genrand(seed_ ? seed_ : (unsigned)time(NULL));
+  for (lmn_word i = 0; i < n; i++) {
+    keys[i]   = (genrand_int32() & key_mask_) + 1;
+    values[i] = (lmn_data_t)keys[i];
+  }
+  for (int bulk = 1; bulk >= 0; bulk--) {
+    hashmap_t map;
+    init_map(&map, type, mem_slots_log2, tier_dir);
+    double start = gettimeofday_sec();
+    if (bulk) {
+      hashmap_bulk_load(&map, keys, values, n, nthreads);
+    } else {
+      put_bench_t b = { &map, keys, values, n };
+      RunParallel(nthreads, put_worker, &b);
+    }
+    double sec = gettimeofday_sec() - start;
+    lmn_word wrong = 0;
+    for (lmn_word i = 0; i < n; i++) {
+      if (hashmap_find(&map, keys[i]) != values[i]) wrong++;
+    }
+    printf("%s: %lu pairs, %d thread, %lf s, %.3lf Mpairs/s, %lu entries, %lu wrong\n", bulk ? "bulk load" : "put", n, nthreads, sec, n / sec / 1000000.0, hashmap_count(&map, nthreads), wrong);
+    hashmap_free(&map);
+  }
+  free(keys);
+  free(values);
+}
+
+#define UPDATES (1 << 20)
+
+typedef struct {
+  hashmap_t *map;
+  lmn_word   counters;
+} update_bench_t;
+
+static void update_worker(int index, int nthreads, void *arg) {
+  update_bench_t *b = (update_bench_t*)arg;
+  unsigned long x = 88172645463325252UL ^ (seed_ + index + 1);
+  for (int i = 0; i < UPDATES; i++) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    lmn_key_t key = x % b->counters + 1;
+    hashmap_fetch_add(b->map, key, 1);
+    hashmap_update(b->map, key + b->counters, hashmap_combine_min, (lmn_data_t)(x % 1000 + 1));
+  }
+}
+
+/* concurrent fetch_add on a few counters, checked against the number of increments */
+static void run_update(hashmap_type_t type, int mem_slots_log2, const char *tier_dir, lmn_word counters, int nthreads) {
+  hashmap_t map;
+  init_map(&map, type, mem_slots_log2, tier_dir);
+  update_bench_t b = { &map, counters };
+  double start = gettimeofday_sec();
+  RunParallel(nthreads, update_worker, &b);
+  double sec = gettimeofday_sec() - start;
+  lmn_word sum = 0, min = (lmn_word)-1;
+  for (lmn_word key = 1; key <= counters; key++) {
+    sum += (lmn_word)hashmap_find(&map, key);
+    lmn_word m = (lmn_word)hashmap_find(&map, key + counters);
+    if (m != 0 && m < min) min = m;
+  }
+  printf("update: %lu counters, %d thread, %lf s, %.3lf Mops/s, sum %lu (expected %lu), min %lu\n", counters, nthreads, sec, 2.0 * UPDATES * nthreads / sec / 1000000.0, sum, (lmn_word)UPDATES * nthreads, min);
+  hashmap_free(&map);
+}
 
 int main(int argc, char **argv){
 
@@ -235,19 +542,47 @@ int main(int argc, char **argv){
   char      algrithm[128] = {0};
   int               count = 1;
   int          thread_num = 1;
-
-  while((result=getopt(argc,argv,"a:c:n:"))!=-1){
+  int                scan = 0;
+  int              freeze = 0;
+  int               batch = 0;
+  lmn_word         bulk_n = 0;
+  lmn_word       counters = 0;
+  int          front_bits = 0;
+  lmn_word     stats_stride = 0;
+  int           keys_only = 0;
+  int      bits_per_state = DEFAULT_BITS_PER_STATE;
+  lmn_word expected_states = DEFAULT_EXPECTED_STATES;
+  int      mem_slots_log2 = 0;
+  int        probe_policy = -1;
+  double   probe_max_load = 0;
+  const char *tier_dir    = TIERED_DEFAULT_DIR;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+
+  while((result=getopt(argc,argv,"a:B:b:c:d:De:fF:HkK:l:L:m:n:PR:r:S:p:sT:u:"))!=-1){
     switch(result){
       case 'a':
         if (strcmp(ALG_NAME_LOCK_CHAINED_HASHMAP, optarg) == 0 ||
         strcmp(ALG_NAME_LOCK_FREE_CHAINED_HASHMAP, optarg) == 0 ||
-        strcmp(ALG_NAME_CC_HASHMAP, optarg) == 0) {
+        strcmp(ALG_NAME_CC_HASHMAP, optarg) == 0 ||
+        strcmp(ALG_NAME_BITSTATE, optarg) == 0 ||
+        strcmp(ALG_NAME_CUCKOO_HASHMAP, optarg) == 0 ||
+        strcmp(ALG_NAME_CC_COMPACT_HASHMAP, optarg) == 0 ||
+        strcmp(ALG_NAME_COMBINING_CHAINED_HASHMAP, optarg) == 0 ||
+        strcmp(ALG_NAME_SHARDED_HASHMAP, optarg) == 0 ||
+        strcmp(ALG_NAME_TIERED_HASHMAP, optarg) == 0) {
           strcpy(algrithm, optarg); 
         } else {
           fprintf(stderr, "unknown algrithm!! require below each names.\n");
           fprintf(stderr, "Lock Based Chain HashMap : %s\n", ALG_NAME_LOCK_CHAINED_HASHMAP);
           fprintf(stderr, "%s\n", ALG_NAME_LOCK_FREE_CHAINED_HASHMAP);
+          fprintf(stderr, "Flat Combining Chain HashMap : %s\n", ALG_NAME_COMBINING_CHAINED_HASHMAP);
           fprintf(stderr, "Cliff Click Hash Table for Model Checking %s\n", ALG_NAME_CC_HASHMAP);
+          fprintf(stderr, "Concurrent Cuckoo HashMap %s\n", ALG_NAME_CUCKOO_HASHMAP);
+          fprintf(stderr, "Compact (32-bit key/value) Cliff Click HashMap %s\n", ALG_NAME_CC_COMPACT_HASHMAP);
+          fprintf(stderr, "Sharded HashMap (insert only, compared with %s) %s\n", ALG_NAME_CC_HASHMAP, ALG_NAME_SHARDED_HASHMAP);
+          fprintf(stderr, "Tiered Cliff Click HashMap (-m log2 of memory slots, -d run directory) %s\n", ALG_NAME_TIERED_HASHMAP);
+          fprintf(stderr, "Bitstate Hashing (keys only, -b bits per state, -e expected states) %s\n", ALG_NAME_BITSTATE);
           exit(-1);
         }
         break;
@@ -255,27 +590,232 @@ int main(int argc, char **argv){
       case 'n':
         num_threads_ = thread_num = atoi(optarg);
         break;
+      case 's':
+        scan = 1;
+        break;
+      case 'k':
+        keys_only = 1;
+        break;
+      case 'f':
+        freeze = 1;
+        break;
+      case 'K':
+        if ((lock_policy_ = chain_lock_policy_by_name(optarg)) < 0) {
+          fprintf(stderr, "unknown lock policy %s (mutex, ttas, ticket, mcs or rw)\n", optarg);
+          exit(-1);
+        }
+        break;
+      case 'B':
+        batch = atoi(optarg);
+        if (batch < 1 || batch > MAX_BATCH) {
+          fprintf(stderr, "batch size must be within 1..%d\n", MAX_BATCH);
+          exit(-1);
+        }
+        break;
+      case 'l':
+        bulk_n = strtoul(optarg, NULL, 10);
+        break;
+      case 'u':
+        counters = strtoul(optarg, NULL, 10);
+        break;
+      case 'D':
+        dup_ = 1;
+        break;
+      case 'F':
+        front_bits = atoi(optarg);
+        if (front_bits < 1 || front_bits > 24) {
+          fprintf(stderr, "front cache bits must be within 1..24\n");
+          exit(-1);
+        }
+        break;
+      case 'P':
+        perf_ = 1;
+        break;
+      case 'T':
+        stats_stride = strtoul(optarg, NULL, 10);
+        break;
+      case 'R':
+        record_path = optarg;
+        break;
+      case 'r':
+        replay_path = optarg;
+        break;
+      case 'S':
+        seed_ = strtoul(optarg, NULL, 10);
+        break;
+      case 'H':
+        lmn_table_set_huge_pages(TRUE);
+        break;
+      case 'b':
+        bits_per_state = atoi(optarg);
+        break;
+      case 'e':
+        expected_states = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        mem_slots_log2 = atoi(optarg);
+        break;
+      case 'd':
+        tier_dir = optarg;
+        break;
+      case 'p':
+        if ((probe_policy = lmn_hashmap_probe_by_name(optarg)) < 0) {
+          fprintf(stderr, "unknown probe policy %s (linear, quad or rehash)\n", optarg);
+          exit(-1);
+        }
+        break;
+      case 'L':
+        probe_max_load = atof(optarg);
+        break;
     }
   }
   if (algrithm[0] == 0x00) {
     strcpy(algrithm, ALG_NAME_LOCK_CHAINED_HASHMAP);
   }
 
+  if (strcmp(ALG_NAME_SHARDED_HASHMAP, algrithm) == 0) {
+    LMN_DBG("Sharded HashMap\n");
+    sharded_hashmap_t sharded;
+    sharded_init(&sharded, thread_num);
+    ShardTest *workers = new ShardTest[thread_num];
+    for (int i = 0; i < thread_num; i++) {
+      workers[i].initialize(&sharded);
+      pthread_mutex_init(&mutex[i], NULL);
+      pthread_mutex_lock(&mutex[i]);
+    }
+    for (int i = 0; i < thread_num; i++) {
+      workers[i].Start();
+    }
+    sleep(1);
+    for (int i = 0; i < thread_num; i++) {
+      pthread_mutex_unlock(&mutex[i]);
+    }
+    int ops = 0;
+    int during = 2000000;
+    perf_counter_values_t perf_sum;
+    memset(&perf_sum, 0x00, sizeof(perf_sum));
+    usleep(during);
+    stop_ = 1;
+    for (int i = 0; i < thread_num; i++) {
+      workers[i].Join();
+      ops += workers[i].ops;
+      perf_counter_add(&perf_sum, &workers[i].perf_values);
+    }
+    printf("sharded: %d thread, %lf s, %.3lf Mops/s, per-thread %.3lf, %lu entries\n", thread_num, ((double)during/U_SEC), ((double)ops / ((double)during/U_SEC)) / 1000000.0, ((double)ops / ((double)during/U_SEC)) / 1000000.0 / thread_num, sharded_count(&sharded));
+    if (perf_) perf_counter_print(&perf_sum, ops);
+    sharded_free(&sharded);
+    delete [] workers;
+
+    // the same insert-only workload on the shared CC map
+    stop_ = 0;
+    insert_only_ = 1;
+    strcpy(algrithm, ALG_NAME_CC_HASHMAP);
+    printf("shared %s (insert only):\n", ALG_NAME_CC_HASHMAP);
+  }
+
   hashmap_t map;
+  hashset_t set;
+  hashmap_type_t type = LMN_CLOSED_ADDRESSING;
   if (strcmp(ALG_NAME_LOCK_CHAINED_HASHMAP, algrithm) == 0) {
     LMN_DBG("ConcurrentChainHashMap\n");
-    hashmap_init(&map, LMN_CLOSED_ADDRESSING);
+    type = LMN_CLOSED_ADDRESSING;
   } else if (strcmp(ALG_NAME_LOCK_FREE_CHAINED_HASHMAP, algrithm) == 0) {
     LMN_DBG("LockFreeChainHashMap\n");
-    hashmap_init(&map, LMN_LOCK_FREE_CLOSED_ADDRESSING);
+    type = LMN_LOCK_FREE_CLOSED_ADDRESSING;
   } else if (strcmp(ALG_NAME_CC_HASHMAP, algrithm) == 0) {
     LMN_DBG("Cliff Click HashMap For Model Checking\n");
-    hashmap_init(&map, LMN_MC_CLIFF_CLICK);
+    type = LMN_MC_CLIFF_CLICK;
+  } else if (strcmp(ALG_NAME_TIERED_HASHMAP, algrithm) == 0) {
+    LMN_DBG("Tiered Cliff Click HashMap\n");
+    type = LMN_MC_CLIFF_CLICK_TIERED;
+    keys_only = 0; // no set specialization
+  } else if (strcmp(ALG_NAME_COMBINING_CHAINED_HASHMAP, algrithm) == 0) {
+    LMN_DBG("FlatCombiningChainHashMap\n");
+    type = LMN_CLOSED_ADDRESSING_COMBINING;
+  } else if (strcmp(ALG_NAME_CUCKOO_HASHMAP, algrithm) == 0) {
+    LMN_DBG("Concurrent Cuckoo HashMap\n");
+    type = LMN_CUCKOO;
+  } else if (strcmp(ALG_NAME_CC_COMPACT_HASHMAP, algrithm) == 0) {
+    LMN_DBG("Compact Cliff Click HashMap For Model Checking\n");
+    type = LMN_MC_CLIFF_CLICK_COMPACT;
+    key_mask_ = 0x7fffffffUL; // keys and values have to fit into 32 bits
+  } else if (strcmp(ALG_NAME_BITSTATE, algrithm) == 0) {
+    LMN_DBG("Bitstate Hashing\n");
+    type = LMN_BITSTATE;
+    keys_only = 1;
+  }
+  if (bulk_n || counters) {
+    if (keys_only || type == LMN_BITSTATE) {
+      fprintf(stderr, "bulk load and update need a map (no -k, no bitstate)\n");
+      exit(-1);
+    }
+    if (bulk_n) run_bulk_load(type, mem_slots_log2, tier_dir, bulk_n, thread_num);
+    if (counters) run_update(type, mem_slots_log2, tier_dir, counters, thread_num);
+    return 0;
+  }
+  map.data = set.data = NULL;
+  if (type == LMN_BITSTATE) {
+    // k = bits per state * ln 2 minimizes the omission probability
+    int nhashes = (int)(bits_per_state * 0.693 + 0.5);
+    if (nhashes < 1) nhashes = 1;
+    if (nhashes > BITSTATE_MAX_HASH) nhashes = BITSTATE_MAX_HASH;
+    hashset_bitstate_init(&set, (lmn_word)bits_per_state * expected_states, nhashes);
+  } else if (keys_only) {
+    LMN_DBG("keys only\n");
+    hashset_init(&set, type);
+  } else {
+    init_map(&map, type, mem_slots_log2, tier_dir);
   }
-  if (map.data) {
+  // the probe policy of the CC table (or of the memory tier)
+  lmn_hashmap_t *cc = NULL;
+  if (type == LMN_MC_CLIFF_CLICK)
+    cc = (lmn_hashmap_t*)(keys_only ? set.data : map.data);
+  else if (type == LMN_MC_CLIFF_CLICK_TIERED)
+    cc = &((tiered_hashmap_t*)map.data)->mem;
+  if (cc && (probe_policy >= 0 || probe_max_load > 0)) {
+    lmn_hashmap_set_probe(cc, probe_policy >= 0 ? probe_policy : cc->current->probe, probe_max_load > 0 ? probe_max_load : CC_PROBE_DEFAULT_LOAD);
+    lmn_hashmap_probe_stats(cc, TRUE);
+  } else {
+    cc = NULL;
+  }
+  if (type == LMN_MC_CLIFF_CLICK_COMPACT && (probe_policy >= 0 || probe_max_load > 0)) {
+    cc_compact_set_probe((cc_compact_hashmap_t*)(keys_only ? set.data : map.data), probe_policy >= 0 ? probe_policy : CC_PROBE_LINEAR, probe_max_load > 0 ? probe_max_load : CC_PROBE_DEFAULT_LOAD);
+  }
+  if (replay_path) {
+    hashmap_trace_file_t trace;
+    if (!map.data) {
+      fprintf(stderr, "replay needs a map (no -k, no bitstate)\n");
+      exit(-1);
+    }
+    if (!hashmap_trace_map(&trace, replay_path)) {
+      fprintf(stderr, "can not read trace %s\n", replay_path);
+      exit(-1);
+    }
+    printf("table backing: %s\n", lmn_table_backing_name(lmn_table_backing()));
+    run_replay(&map, &trace);
+    print_huge_backing();
+    hashmap_trace_unmap(&trace);
+    hashmap_free(&map);
+    return 0;
+  }
+  if (record_path && map.data) {
+    hashmap_trace_start(&map, record_path);
+  }
+  if (dup_ && !map.data) {
+    fprintf(stderr, "find_or_put needs a map (no -k, no bitstate)\n");
+    exit(-1);
+  }
+  if (front_bits && map.data) {
+    hashmap_front_start(&map, front_bits);
+  }
+  if (map.data || set.data) {
+    printf("table backing: %s\n", lmn_table_backing_name(lmn_table_backing()));
     HashMapTest *threads = new HashMapTest[thread_num];
     for (int i = 0; i < thread_num; i++) {
-      threads[i].initialize(&map);
+      if (keys_only)
+        threads[i].initialize(&set);
+      else
+        threads[i].initialize(&map);
       pthread_mutex_init(&mutex[i], NULL);
       pthread_mutex_lock(&mutex[i]);
     }
@@ -289,15 +829,94 @@ int main(int argc, char **argv){
     LMN_DBG("start benchmark\n");
     int ops = 0;
     int during = 2000000;
+    perf_counter_values_t perf_sum;
+    memset(&perf_sum, 0x00, sizeof(perf_sum));
     usleep(during);
     stop_ = 1;
     for (int i = 0; i < thread_num; i++) {
       threads[i].Join();
       ops += threads[i].ops;
+      perf_counter_add(&perf_sum, &threads[i].perf_values);
     }
     //printf("%lfs Mops/s %lf per-thread %lf\n", cpu_time, ((double)COUNT / cpu_time) / 1000000.0 , ((double)COUNT/cpu_time/thread_num) / 1000000.0);
     printf("%d thread, %lf s, %.3lf Mops/s, per-thread %.3lf\n", thread_num, ((double)during/U_SEC), ((double)ops / ((double)during/U_SEC)) / 1000000.0, ((double)ops / ((double)during/U_SEC)) / 1000000.0 / thread_num );
+    print_huge_backing();
+    if (perf_) perf_counter_print(&perf_sum, ops);
+    if (record_path && map.data) {
+      hashmap_trace_stop(&map);
+      printf("recorded %s\n", record_path);
+    }
     //printf("%lfs Mops/s %lf per-thread %lf\n", during, ((double)ops/ during) / 1000000.0 , ((double)ops/during) / 1000000.0);
-    hashmap_free(&map);
+    if (front_bits && map.data) {
+      lmn_word hits, lookups;
+      hashmap_front_stats(&map, &hits, &lookups);
+      printf("front cache: %lu of %lu lookups hit (%.2lf%%)\n", hits, lookups, lookups ? 100.0 * hits / lookups : 0.0);
+    }
+    if (stats_stride && !keys_only && type != LMN_BITSTATE) {
+      if (map.impl.stats != NULL) {
+        hashmap_stats_t stats;
+        start = gettimeofday_sec();
+        hashmap_stats_sampled(&map, &stats, thread_num, stats_stride);
+        end = gettimeofday_sec();
+        hashmap_stats_print(stdout, &stats);
+        printf("stats: 1 of every %lu chunks walked in %lf s\n", stats_stride, end - start);
+      } else {
+        printf("stats: not supported by %s\n", algrithm);
+      }
+    }
+    if (scan && !keys_only) {
+      start = gettimeofday_sec();
+      lmn_word entries = hashmap_count(&map, thread_num);
+      end = gettimeofday_sec();
+      printf("scan: %lu entries, %lf s\n", entries, end - start);
+    }
+    if (cc) {
+      lmn_word hist[CC_PROBE_HIST], total = 0;
+      lmn_hashmap_probe_histogram(cc, hist);
+      for (int i = 0; i < CC_PROBE_HIST; i++) total += hist[i];
+      printf("probe lines (max %d):", cc->current->max_lines);
+      for (int i = 0; i < CC_PROBE_HIST; i++) {
+        if (hist[i]) printf(" %s%d:%.4lf%%", (i == CC_PROBE_HIST - 1) ? ">=" : "", i + 1, 100.0 * hist[i] / total);
+      }
+      printf("\n");
+    }
+    if (batch && !keys_only && type != LMN_BITSTATE) {
+      lmn_word   nkeys = hashmap_count(&map, thread_num);
+      lmn_key_t *keys  = (lmn_key_t*)malloc(sizeof(lmn_key_t) * (nkeys + 1));
+      nkeys = hashmap_export(&map, keys, NULL, nkeys, thread_num);
+      if (nkeys > 0) {
+        printf("find: single %.3lf Mops/s, batch of %d %.3lf Mops/s\n", lookup_rate(&map, keys, nkeys, 0, thread_num), batch, lookup_rate(&map, keys, nkeys, batch, thread_num));
+      }
+      free(keys);
+    }
+    if (freeze && !keys_only && type != LMN_BITSTATE) {
+      hashmap_t frozen;
+      start = gettimeofday_sec();
+      hashmap_freeze(&map, &frozen, thread_num);
+      end = gettimeofday_sec();
+      frozen_hashmap_t *fz = (frozen_hashmap_t*)frozen.data;
+      printf("freeze: %lu entries, %lu bytes (%.1lf B/entry), %lf s\n", fz->count, frozen_bytes(fz), (double)frozen_bytes(fz) / fz->count, end - start);
+      if (fz->count > 0) {
+        lmn_key_t *keys = (lmn_key_t*)malloc(sizeof(lmn_key_t) * fz->count);
+        for (lmn_word i = 0; i < fz->count; i++) keys[i] = fz->entries[i].key;
+        printf("read-only find: source %.3lf Mops/s, frozen %.3lf Mops/s\n", lookup_rate(&map, keys, fz->count, 0, thread_num), lookup_rate(&frozen, keys, fz->count, 0, thread_num));
+        free(keys);
+      }
+      hashmap_free(&frozen);
+    }
+    if (type == LMN_BITSTATE) {
+      bitstate_hashmap_t *bs = (bitstate_hashmap_t*)set.data;
+      printf("bitstate: %lu bits, %d hashes, %lu states, omission probability %e\n", bitstate_nbits(bs), bs->nhashes, bitstate_count(bs), bitstate_omission_probability(bs));
+    }
+    if (type == LMN_MC_CLIFF_CLICK_TIERED) {
+      tiered_hashmap_t *tier = (tiered_hashmap_t*)map.data;
+      printf("tiered: %lu memory slots, %lu entries beyond memory, %d runs, %lu block reads\n", lmn_hashmap_slots(&tier->mem), tiered_overflow_count(tier), tiered_run_count(tier), tier->disk_reads);
+    }
+    if (keys_only) {
+      hashset_free(&set);
+    } else {
+      hashmap_front_stop(&map);
+      hashmap_free(&map);
+    }
   }
 }
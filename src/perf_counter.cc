@@ -0,0 +1,115 @@
+/**
+ * @file   perf_counter.cc
+ * @brief
+ * @author Taketo Yoshida
+ */
+#include "perf_counter.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+static const char *perf_counter_names[PERF_COUNTER_EVENTS] = {
+  "cycles", "instructions", "LLC-misses", "dTLB-misses", "branch-misses"
+};
+
+static void perf_counter_attr(int event, struct perf_event_attr *attr) {
+  memset(attr, 0x00, sizeof(struct perf_event_attr));
+  attr->size           = sizeof(struct perf_event_attr);
+  attr->disabled       = 1;
+  attr->exclude_kernel = 1;
+  attr->exclude_hv     = 1;
+  attr->read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr->type           = PERF_TYPE_HARDWARE;
+  switch (event) {
+    case PERF_COUNTER_CYCLES:
+      attr->config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_COUNTER_INSTRUCTIONS:
+      attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_COUNTER_LLC_MISSES:
+      attr->type   = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_COUNTER_DTLB_MISSES:
+      attr->type   = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_COUNTER_BRANCH_MISSES:
+      attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+  }
+}
+
+/* returns the number of events that could be opened */
+int perf_counter_open(perf_counter_t *pc) {
+  int opened = 0;
+  for (int i = 0; i < PERF_COUNTER_EVENTS; i++) {
+    struct perf_event_attr attr;
+    perf_counter_attr(i, &attr);
+    pc->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (pc->fd[i] >= 0) opened++;
+  }
+  return opened;
+}
+
+void perf_counter_start(perf_counter_t *pc) {
+  for (int i = 0; i < PERF_COUNTER_EVENTS; i++) {
+    if (pc->fd[i] < 0) continue;
+    ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+/* adds the counts since perf_counter_start to sum */
+void perf_counter_stop(perf_counter_t *pc, perf_counter_values_t *sum) {
+  for (int i = 0; i < PERF_COUNTER_EVENTS; i++) {
+    uint64_t buf[3]; // value, time enabled, time running
+    if (pc->fd[i] < 0) continue;
+    ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(pc->fd[i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) continue;
+    sum->values[i] += (double)buf[0] * ((double)buf[1] / (double)buf[2]);
+    sum->valid[i]   = 1;
+  }
+}
+
+void perf_counter_close(perf_counter_t *pc) {
+  for (int i = 0; i < PERF_COUNTER_EVENTS; i++) {
+    if (pc->fd[i] >= 0) close(pc->fd[i]);
+    pc->fd[i] = -1;
+  }
+}
+
+void perf_counter_add(perf_counter_values_t *sum, perf_counter_values_t *values) {
+  for (int i = 0; i < PERF_COUNTER_EVENTS; i++) {
+    sum->values[i] += values->values[i];
+    sum->valid[i]  |= values->valid[i];
+  }
+}
+
+const char *perf_counter_name(int event) {
+  return perf_counter_names[event];
+}
+
+/* one line of per-operation values, with IPC when both cycles and instructions were counted */
+void perf_counter_print(perf_counter_values_t *sum, double ops) {
+  int any = 0;
+  printf("perf per op:");
+  for (int i = 0; i < PERF_COUNTER_EVENTS; i++) {
+    if (!sum->valid[i]) {
+      printf(" %s n/a", perf_counter_names[i]);
+      continue;
+    }
+    printf(" %s %.2lf", perf_counter_names[i], ops > 0 ? sum->values[i] / ops : 0.0);
+    any = 1;
+  }
+  if (sum->valid[PERF_COUNTER_CYCLES] && sum->valid[PERF_COUNTER_INSTRUCTIONS] && sum->values[PERF_COUNTER_CYCLES] > 0) {
+    printf(", IPC %.2lf", sum->values[PERF_COUNTER_INSTRUCTIONS] / sum->values[PERF_COUNTER_CYCLES]);
+  }
+  if (!any) printf(" (counters unavailable: no PMU access or perf_event_paranoid too high)");
+  printf("\n");
+}
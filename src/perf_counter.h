@@ -0,0 +1,39 @@
+/**
+ * @file   perf_counter.h
+ * @brief
+ * Per-thread hardware performance counters (perf_event_open) for the benchmark harness.
+ * Each event is opened on its own; events the kernel or the machine does not provide
+ * are simply left out of the report.
+ * @author Taketo Yoshida
+ */
+#ifndef PERF_COUNTER_H
+#  define PERF_COUNTER_H
+
+#define PERF_COUNTER_CYCLES        0
+#define PERF_COUNTER_INSTRUCTIONS  1
+#define PERF_COUNTER_LLC_MISSES    2
+#define PERF_COUNTER_DTLB_MISSES   3
+#define PERF_COUNTER_BRANCH_MISSES 4
+#define PERF_COUNTER_EVENTS        5
+
+/* counters of the calling thread, user space only */
+typedef struct {
+  int fd[PERF_COUNTER_EVENTS]; // -1 when the event could not be opened
+} perf_counter_t;
+
+/* counts summed over threads, scaled up when the kernel multiplexed an event */
+typedef struct {
+  double values[PERF_COUNTER_EVENTS];
+  int    valid[PERF_COUNTER_EVENTS];
+} perf_counter_values_t;
+
+int perf_counter_open(perf_counter_t *pc);
+void perf_counter_start(perf_counter_t *pc);
+void perf_counter_stop(perf_counter_t *pc, perf_counter_values_t *sum);
+void perf_counter_close(perf_counter_t *pc);
+void perf_counter_add(perf_counter_values_t *sum, perf_counter_values_t *values);
+const char *perf_counter_name(int event);
+void perf_counter_print(perf_counter_values_t *sum, double ops);
+
+#endif /* ifndef PERF_COUNTER_H */
+